@@ -0,0 +1,874 @@
+// Microbenchmarks of the decoders and end-to-end parse throughput over
+// generated corpora. Results can be written as JSON and compared against a
+// stored baseline, e.g.
+//   ./rdb_bench -o baseline.json
+//   ./rdb_bench -b baseline.json
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "include/rdbparse.h"
+#include "include/rdb_writer.h"
+#include "src/rdbparse_impl.h"
+#include "src/rdb_generator.h"
+#include "src/ziplist.h"
+#include "src/zipmap.h"
+#include "src/intset.h"
+#include "src/lzf.h"
+#include "src/numeric.h"
+#include "src/util.h"
+
+// Every allocation of the process is counted, benchmarks report the
+// allocations made per item.
+static uint64_t g_allocs = 0;
+
+void *operator new(size_t n) {
+  g_allocs++;
+  void *p = malloc(n ? n : 1);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void PrintHelp() {
+  printf("./rdb_bench [-s corpus_bytes] [-t seconds] [-f filter] [-d dir] [-S seed] [-v]\n"
+      "            [-o results.json] [-b baseline.json] [-r max_regression_pct]\n"
+      "  -s  size of each generated corpus, K/M/G suffixes allowed (64M)\n"
+      "  -t  minimum run time of every benchmark (1)\n"
+      "  -f  only run benchmarks whose name contains the filter\n"
+      "  -o  write the results as JSON\n"
+      "  -b  compare MB/s against a JSON baseline, exit 2 on regressions\n"
+      "  -r  slowdown in percent reported as a regression (10)\n"
+      "  -v  print the ParseStats of the e2e_*_stats runs\n");
+}
+
+namespace parser {
+
+// Reaches the private decoders of RdbParseImpl.
+class RdbParseBench {
+  public:
+    static Status LoadLength(RdbParseImpl *impl, uint64_t *len) {
+      return impl->LoadLength(len, NULL);
+    }
+    static Status LoadString(RdbParseImpl *impl, std::string *str) {
+      return impl->LoadString(str);
+    }
+};
+
+}
+
+using namespace parser;
+
+struct BenchResult {
+  std::string name;
+  uint64_t bytes;
+  uint64_t items;
+  uint64_t allocs;
+  double secs;
+  double p50_ns;
+  double p99_ns;
+
+  double MBps() const { return secs > 0 ? bytes / secs / (1 << 20) : 0; }
+  double ItemsPerSec() const { return secs > 0 ? items / secs : 0; }
+  double AllocsPerItem() const { return items ? double(allocs) / items : 0; }
+};
+
+// Latency samples in nanoseconds per item.
+class Latency {
+  public:
+    void Add(double ns) { samples_.push_back(static_cast<float>(ns)); }
+    double Percentile(double p) {
+      if (samples_.empty()) {
+        return 0;
+      }
+      size_t n = static_cast<size_t>(p * (samples_.size() - 1));
+      std::nth_element(samples_.begin(), samples_.begin() + n, samples_.end());
+      return samples_[n];
+    }
+  private:
+    std::vector<float> samples_;
+};
+
+class Bench {
+  public:
+    Bench() : min_secs(1), corpus_bytes(64 << 20), dir("/tmp"), seed(1),
+      verbose(false), mismatches(0), failures(0) {}
+
+    double min_secs;
+    uint64_t corpus_bytes;
+    std::string dir;
+    std::string filter;
+    uint64_t seed;
+    bool verbose;
+    std::vector<BenchResult> results;
+    // results differing from the reference implementation
+    uint64_t mismatches;
+    // benchmarks that could not run
+    uint64_t failures;
+
+    bool Selected(const std::string &name) const {
+      return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // Run |round| until min_secs passed, after one warm up round. Every
+    // round processes |bytes| and |items| and is one latency sample, unless
+    // |item_samples| is set and the round samples each item itself.
+    void Run(const std::string &name, uint64_t bytes, uint64_t items,
+        const std::function<void(Latency *)> &round, bool item_samples = false) {
+      if (items == 0) {
+        return;
+      }
+      Latency latency;
+      round(NULL);
+      BenchResult r = BenchResult();
+      r.name = name;
+      uint64_t allocs = g_allocs;
+      uint64_t start = NowNanos(), now = start;
+      while (r.bytes == 0 || now - start < min_secs * 1e9) {
+        uint64_t t = NowNanos();
+        round(&latency);
+        now = NowNanos();
+        if (!item_samples) {
+          latency.Add(double(now - t) / items);
+        }
+        r.bytes += bytes;
+        r.items += items;
+      }
+      r.secs = (now - start) / 1e9;
+      r.allocs = g_allocs - allocs;
+      r.p50_ns = latency.Percentile(0.5);
+      r.p99_ns = latency.Percentile(0.99);
+      Report(r);
+    }
+
+    // Same as Run for rounds counting their own items and bytes and taking
+    // their own latency samples. A round failing fails the benchmark.
+    void RunCounted(const std::string &name,
+        const std::function<Status(Latency *, uint64_t *, uint64_t *)> &round) {
+      Latency latency;
+      uint64_t bytes = 0, items = 0;
+      Status s = round(NULL, &bytes, &items);
+      BenchResult r = BenchResult();
+      r.name = name;
+      uint64_t allocs = g_allocs;
+      uint64_t start = NowNanos(), now = start;
+      while (s.ok() && (r.items == 0 || now - start < min_secs * 1e9)) {
+        bytes = items = 0;
+        s = round(&latency, &bytes, &items);
+        now = NowNanos();
+        r.bytes += bytes;
+        r.items += items;
+        if (items == 0) {
+          break;
+        }
+      }
+      if (!s.ok()) {
+        Fail(name, s);
+        return;
+      }
+      r.secs = (now - start) / 1e9;
+      r.allocs = g_allocs - allocs;
+      r.p50_ns = latency.Percentile(0.5);
+      r.p99_ns = latency.Percentile(0.99);
+      Report(r);
+    }
+
+    void Fail(const std::string &name, const Status &s) {
+      printf("%-28s FAILED: %s\n", name.c_str(), s.ToString().c_str());
+      fflush(stdout);
+      failures++;
+    }
+
+    void Report(const BenchResult &r) {
+      printf("%-28s %10.1f MB/s %12.0f items/s %8.2f allocs/item "
+          "%10.0f p50 ns %10.0f p99 ns\n", r.name.c_str(), r.MBps(),
+          r.ItemsPerSec(), r.AllocsPerItem(), r.p50_ns, r.p99_ns);
+      fflush(stdout);
+      results.push_back(r);
+    }
+
+    std::string TempPath(const std::string &name) const {
+      return dir + "/rdb_bench_" + name + "_" + std::to_string(getpid()) + ".rdb";
+    }
+};
+
+static void AppendLength(uint64_t len, std::string *out) {
+  char buf[9];
+  out->append(buf, EncodeLength(len, buf));
+}
+
+static void FillText(uint64_t *rng, size_t n, std::string *out) {
+  static const char *kWords[] = {"alpha ", "beta ", "gamma ", "delta ",
+    "user:1000:", "session ", "{\"id\":", "0000 "};
+  out->clear();
+  while (out->size() < n) {
+    *rng = *rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    out->append(kWords[(*rng >> 33) % 8]);
+    if ((*rng >> 40) % 4 == 0) {
+      out->append(std::to_string(*rng >> 50));
+    }
+  }
+  out->resize(n);
+}
+
+// Write |payload| after an rdb header so RdbParseImpl can read it back.
+static Status WritePayload(const std::string &path, const std::string &payload) {
+  RdbWriter *writer = NULL;
+  Status s = RdbWriter::Open(path, RdbWriterOptions(), &writer);
+  if (s.ok()) {
+    s = writer->WriteHeader(9);
+  }
+  if (s.ok()) {
+    s = writer->WriteRaw(payload.data(), payload.size());
+  }
+  if (s.ok()) {
+    s = writer->Finish();
+  }
+  delete writer;
+  return s;
+}
+
+static void BenchLoadLength(Bench *bench) {
+  const uint64_t kCount = 1 << 20;
+  std::string payload;
+  uint64_t rng = 1;
+  for (uint64_t i = 0; i < kCount; i++) {
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    static const int kBits[] = {6, 6, 6, 14, 14, 32, 64};
+    int bits = kBits[(rng >> 33) % 7];
+    AppendLength((rng >> 1) & ((bits == 64 ? 0 : (1ULL << bits)) - 1), &payload);
+  }
+  std::string path = bench->TempPath("length");
+  if (!WritePayload(path, payload).ok()) {
+    return;
+  }
+  bench->Run("load_length", payload.size(), kCount, [&](Latency *) {
+    RdbParseImpl impl(path, ParseOptions());
+    uint64_t len;
+    if (impl.Init().ok()) {
+      for (uint64_t i = 0; i < kCount; i++) {
+        RdbParseBench::LoadLength(&impl, &len);
+      }
+    }
+  });
+  unlink(path.c_str());
+}
+
+static void BenchLoadString(Bench *bench) {
+  const uint64_t kCount = 1 << 18;
+  std::string payload, value, lzf;
+  uint64_t rng = 2;
+  for (uint64_t i = 0; i < kCount; i++) {
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t kind = (rng >> 33) % 10;
+    if (kind < 2) {
+      int32_t v = static_cast<int32_t>(rng >> 32);
+      payload.push_back(static_cast<char>(0xc0 | RdbParseImpl::kEncInt32));
+      payload.append(reinterpret_cast<const char *>(&v), 4);
+      continue;
+    }
+    FillText(&rng, 8 + (rng >> 40) % (kind < 7 ? 64 : 2048), &value);
+    lzf.resize(value.size());
+    unsigned int n = kind >= 7 ?
+      CompressLzf(value.data(), value.size(), &lzf[0], value.size() - 4) : 0;
+    if (n > 0) {
+      payload.push_back(static_cast<char>(0xc0 | RdbParseImpl::kEncLzf));
+      AppendLength(n, &payload);
+      AppendLength(value.size(), &payload);
+      payload.append(lzf.data(), n);
+    } else {
+      AppendLength(value.size(), &payload);
+      payload.append(value);
+    }
+  }
+  std::string path = bench->TempPath("string");
+  if (!WritePayload(path, payload).ok()) {
+    return;
+  }
+  bench->Run("load_string", payload.size(), kCount, [&](Latency *) {
+    RdbParseImpl impl(path, ParseOptions());
+    std::string str;
+    if (impl.Init().ok()) {
+      for (uint64_t i = 0; i < kCount; i++) {
+        RdbParseBench::LoadString(&impl, &str);
+      }
+    }
+  });
+  unlink(path.c_str());
+}
+
+static void BenchLzf(Bench *bench) {
+  const size_t kChunk = 32 << 10;
+  std::vector<std::string> chunks;
+  std::string text, lzf;
+  uint64_t rng = 3, raw = 0;
+  for (int i = 0; i < 256; i++) {
+    FillText(&rng, kChunk, &text);
+    lzf.resize(kChunk);
+    unsigned int n = CompressLzf(text.data(), text.size(), &lzf[0], kChunk - 4);
+    if (n > 0) {
+      chunks.push_back(lzf.substr(0, n));
+      raw += kChunk;
+    }
+  }
+  std::string out(kChunk, '\0');
+  bench->Run("lzf_decompress", raw, chunks.size(), [&](Latency *) {
+    for (const std::string &c : chunks) {
+      DecompressLzf(c.data(), c.size(), &out[0], kChunk);
+    }
+  });
+}
+
+static void BenchCrc64(Bench *bench) {
+  const size_t kChunk = 64 << 10;
+  std::string buf;
+  uint64_t rng = 4;
+  FillText(&rng, 16 << 20, &buf);
+  uint64_t crc = 0;
+  bench->Run("crc64", buf.size(), buf.size() / kChunk, [&](Latency *) {
+    for (size_t off = 0; off < buf.size(); off += kChunk) {
+      crc = crc64(crc, reinterpret_cast<const unsigned char *>(buf.data()) + off, kChunk);
+    }
+  });
+  if (crc == 1) {
+    printf("\n");  // keep the loop alive
+  }
+}
+
+// Encoded blobs of |type| values, taken from a generated corpus so they
+// match what the parser meets in real files.
+static void CollectBlobs(Bench *bench, const std::string &type,
+    std::vector<std::string> *blobs, uint64_t *bytes) {
+  GeneratorOptions options;
+  options.seed = bench->seed;
+  options.target_bytes = std::min<uint64_t>(bench->corpus_bytes, 16 << 20);
+  options.compress = false;
+  options.expire_ratio = 0;
+  options.lru_ratio = 0;
+  options.elements_mean = 64;
+  options.elements_max = 512;
+  options.SetTypeWeights(type);
+  std::string path = bench->TempPath(type);
+  GeneratorStats stats;
+  if (!RdbGenerator(options).Generate(path, &stats).ok()) {
+    return;
+  }
+  ParseOptions parse_options;
+  parse_options.capture_raw = true;
+  parse_options.decode_value = false;
+  RdbParse *parse;
+  if (!RdbParse::Open(path, parse_options, &parse).ok()) {
+    return;
+  }
+  *bytes = 0;
+  while (parse->Valid() && parse->Next().ok()) {
+    const std::string &raw = parse->Value()->raw_value;
+    if (parse->Value()->key.empty() || raw.empty()) {
+      continue;
+    }
+    // strip the length in front of the uncompressed string
+    uint8_t b = static_cast<uint8_t>(raw[0]);
+    size_t skip = (b >> 6) == 0 ? 1 : (b >> 6) == 1 ? 2 : b == 0x80 ? 5 : 9;
+    blobs->push_back(raw.substr(skip));
+    *bytes += blobs->back().size();
+  }
+  delete parse;
+  unlink(path.c_str());
+}
+
+static void BenchZiplist(Bench *bench) {
+  std::vector<std::string> lists, hashes;
+  uint64_t list_bytes = 0, hash_bytes = 0;
+  CollectBlobs(bench, "list_ziplist", &lists, &list_bytes);
+  CollectBlobs(bench, "hash_ziplist", &hashes, &hash_bytes);
+  bench->Run("ziplist_list", list_bytes, lists.size(), [&](Latency *latency) {
+    std::list<std::string> result;
+    for (std::string &blob : lists) {
+      uint64_t t = NowNanos();
+      result.clear();
+      ZiplistParser(&blob[0], blob.size()).GetList(&result);
+      if (latency) {
+        latency->Add(NowNanos() - t);
+      }
+    }
+  }, true);
+  bench->Run("ziplist_hash", hash_bytes, hashes.size(), [&](Latency *latency) {
+    std::map<std::string, std::string> result;
+    for (std::string &blob : hashes) {
+      uint64_t t = NowNanos();
+      result.clear();
+      ZiplistParser(&blob[0], blob.size()).GetZsetOrHash(&result);
+      if (latency) {
+        latency->Add(NowNanos() - t);
+      }
+    }
+  }, true);
+  // both passes without building strings
+  bench->Run("ziplist_scan", hash_bytes, hashes.size(), [&](Latency *latency) {
+    std::vector<ZiplistEntry> entries;
+    char buf[24];
+    size_t sum = 0;
+    for (std::string &blob : hashes) {
+      uint64_t t = NowNanos();
+      ZiplistParser parser(&blob[0], blob.size());
+      if (parser.Scan(&entries).ok()) {
+        for (const ZiplistEntry &e : entries) {
+          sum += parser.Value(e, buf).size();
+        }
+      }
+      if (latency) {
+        latency->Add(NowNanos() - t);
+      }
+    }
+    if (sum == 1) {
+      printf("\n");  // keep the loop alive
+    }
+  }, true);
+}
+
+static void BenchZipmap(Bench *bench) {
+  std::vector<std::string> maps;
+  uint64_t bytes = 0;
+  CollectBlobs(bench, "hash_zipmap", &maps, &bytes);
+  bench->Run("zipmap", bytes, maps.size(), [&](Latency *latency) {
+    std::map<std::string, std::string> result;
+    for (std::string &blob : maps) {
+      uint64_t t = NowNanos();
+      result.clear();
+      ZipmapParser(&blob[0], blob.size()).GetMap(&result);
+      if (latency) {
+        latency->Add(NowNanos() - t);
+      }
+    }
+  }, true);
+}
+
+static void BenchIntset(Bench *bench) {
+  std::vector<std::string> sets;
+  uint64_t bytes = 0;
+  CollectBlobs(bench, "intset", &sets, &bytes);
+  bench->Run("intset_get", bytes, sets.size(), [&](Latency *latency) {
+    int64_t v, sum = 0;
+    for (std::string &blob : sets) {
+      uint64_t t = NowNanos();
+      Intset *set = reinterpret_cast<Intset *>(&blob[0]);
+      for (uint32_t i = 0; i < set->length; i++) {
+        set->Get(i, &v);
+        sum += v;
+      }
+      if (latency) {
+        latency->Add(NowNanos() - t);
+      }
+    }
+    if (sum == 1) {
+      printf("\n");  // keep the loop alive
+    }
+  }, true);
+  bench->Run("intset_get_all", bytes, sets.size(), [&](Latency *latency) {
+    std::vector<int64_t> values;
+    int64_t sum = 0;
+    for (std::string &blob : sets) {
+      uint64_t t = NowNanos();
+      Intset *set = reinterpret_cast<Intset *>(&blob[0]);
+      values.resize(set->length);
+      set->GetAll(values.data());
+      sum += values.empty() ? 0 : values.back();
+      if (latency) {
+        latency->Add(NowNanos() - t);
+      }
+    }
+    if (sum == 1) {
+      printf("\n");  // keep the loop alive
+    }
+  }, true);
+}
+
+static void Mismatch(Bench *bench, const char *what, const std::string &input) {
+  if (bench->mismatches++ < 10) {
+    printf("%s differs from libc for \"%s\"\n", what, input.c_str());
+  }
+}
+
+// string2ll, string2d and FormatInt64 are checked against strtoll, strtod
+// and snprintf on random and edge case inputs, then timed next to them.
+static void BenchNumeric(Bench *bench) {
+  const size_t kCount = 1 << 16;
+  std::vector<std::string> ints, doubles;
+  std::vector<int64_t> values;
+  uint64_t rng = 5, int_bytes = 0, double_bytes = 0;
+  char buf[64];
+  for (size_t i = 0; i < kCount; i++) {
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    int64_t v = static_cast<int64_t>(rng) >> ((rng >> 8) % 64);
+    values.push_back(v);
+    ints.push_back(std::to_string(v));
+    int_bytes += ints.back().size();
+
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    double d;
+    if (i % 4 == 0) {
+      // up to 19 digits, any exponent, subnormals and overflow included
+      std::string s = (rng & 1) ? "-" : "";
+      int digits = 1 + (rng >> 1) % 19;
+      for (int j = 0; j < digits; j++) {
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        s.push_back(static_cast<char>('0' + (rng >> 33) % 10));
+      }
+      s.insert(s.size() - (rng >> 40) % digits, ".");
+      s += "e" + std::to_string(static_cast<int>((rng >> 45) % 700) - 350);
+      doubles.push_back(s);
+    } else {
+      uint64_t bits = rng;
+      memcpy(&d, &bits, sizeof(d));
+      if (!std::isfinite(d) || i % 4 == 1) {
+        d = static_cast<double>(static_cast<int64_t>(rng >> 24)) / 1000;
+      }
+      snprintf(buf, sizeof(buf), i % 4 == 3 ? "%g" : "%.17g", d);
+      doubles.push_back(buf);
+    }
+    double_bytes += doubles.back().size();
+  }
+
+  static const char *kIntEdges[] = {"0", "-0", "007", "-007", "", "-", "+1", " 1",
+    "1 ", "12a", "9223372036854775807", "9223372036854775808",
+    "-9223372036854775808", "-9223372036854775809", "18446744073709551616",
+    "00000000000000000000000000001", "12345678", "123456789012345678"};
+  std::vector<std::string> int_checks(ints);
+  int_checks.insert(int_checks.end(), kIntEdges, kIntEdges + sizeof(kIntEdges) / sizeof(kIntEdges[0]));
+  for (const std::string &s : int_checks) {
+    long long v = 0, ref = 0;
+    bool ok = string2ll(s.data(), s.size(), &v);
+    // redis syntax: an optional '-' and digits, nothing else
+    size_t sign = !s.empty() && s[0] == '-' ? 1 : 0;
+    bool ref_ok = s.size() > sign
+      && s.find_first_not_of("0123456789", sign) == std::string::npos;
+    if (ref_ok) {
+      errno = 0;
+      ref = strtoll(s.c_str(), NULL, 10);
+      ref_ok = errno != ERANGE;
+    }
+    if (ok != ref_ok || (ok && v != ref)) {
+      Mismatch(bench, "string2ll", s);
+    }
+  }
+  for (int64_t v : values) {
+    snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+    char out[20];
+    if (std::string(out, FormatInt64(v, out)) != buf) {
+      Mismatch(bench, "FormatInt64", buf);
+    }
+  }
+  static const char *kDoubleEdges[] = {"0", "-0", "0.0", ".5", "5.", ".", "1e", "1e+",
+    "+1.5", " 1", "1 ", "inf", "-inf", "nan", "0x1p3", "1e400", "-1e-400",
+    "4.9406564584124654e-324", "2.4703282292062327e-324", "2.2250738585072011e-308",
+    "1.7976931348623157e308", "1.7976931348623159e308", "9007199254740993",
+    "9007199254740992.5", "0.1", "0.10000000000000001", "123456789012345678901234",
+    "1.00000000000000011102230246251565404236316680908203125", "7.3177701707893310e+15"};
+  std::vector<std::string> double_checks(doubles);
+  double_checks.insert(double_checks.end(), kDoubleEdges,
+      kDoubleEdges + sizeof(kDoubleEdges) / sizeof(kDoubleEdges[0]));
+  for (const std::string &s : double_checks) {
+    double d = 0, ref = 0;
+    bool ok = string2d(s.c_str(), s.size(), &d);
+    char *end;
+    ref = strtod(s.c_str(), &end);
+    bool ref_ok = end == s.c_str() + s.size();
+    if (ok != ref_ok || (ok && memcmp(&d, &ref, sizeof(d)) != 0
+          && !(std::isnan(d) && std::isnan(ref)))) {
+      Mismatch(bench, "string2d", s);
+    }
+  }
+
+  int64_t sum = 0;
+  double dsum = 0;
+  bench->Run("numeric_string2ll", int_bytes, ints.size(), [&](Latency *) {
+    long long v;
+    for (const std::string &s : ints) {
+      string2ll(s.data(), s.size(), &v);
+      sum += v;
+    }
+  });
+  bench->Run("numeric_strtoll", int_bytes, ints.size(), [&](Latency *) {
+    for (const std::string &s : ints) {
+      sum += strtoll(s.c_str(), NULL, 10);
+    }
+  });
+  bench->Run("numeric_string2d", double_bytes, doubles.size(), [&](Latency *) {
+    double d;
+    for (const std::string &s : doubles) {
+      string2d(s.c_str(), s.size(), &d);
+      dsum += d;
+    }
+  });
+  bench->Run("numeric_strtod", double_bytes, doubles.size(), [&](Latency *) {
+    for (const std::string &s : doubles) {
+      dsum += strtod(s.c_str(), NULL);
+    }
+  });
+  bench->Run("numeric_format_int64", int_bytes, values.size(), [&](Latency *) {
+    for (int64_t v : values) {
+      sum += FormatInt64(v, buf);
+    }
+  });
+  bench->Run("numeric_snprintf_int64", int_bytes, values.size(), [&](Latency *) {
+    for (int64_t v : values) {
+      sum += snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+    }
+  });
+  if (sum == 1 || dsum == 1) {
+    printf("\n");  // keep the loops alive
+  }
+}
+
+static void BenchEndToEnd(Bench *bench, const std::string &name,
+    const std::string &weights) {
+  GeneratorOptions options;
+  options.seed = bench->seed;
+  options.target_bytes = bench->corpus_bytes;
+  if (!weights.empty()) {
+    options.SetTypeWeights(weights);
+  }
+  std::string path = bench->TempPath(name);
+  GeneratorStats stats;
+  Status s = RdbGenerator(options).Generate(path, &stats);
+  if (!s.ok()) {
+    bench->Fail("e2e_" + name, s);
+    return;
+  }
+  // decoding, skipping values, and decoding with ParseStats on
+  static const char *kModes[] = {"", "_skip", "_stats"};
+  for (int mode = 0; mode < 3; mode++) {
+    std::string bench_name = "e2e_" + name + kModes[mode];
+    if (!bench->Selected(bench_name)) {
+      continue;
+    }
+    ParseOptions parse_options;
+    parse_options.decode_value = mode != 1;
+    parse_options.collect_stats = mode == 2;
+    std::string stats_text;
+    bench->RunCounted(bench_name, [&](Latency *latency, uint64_t *bytes,
+          uint64_t *items) {
+      RdbParse *parse;
+      Status s = RdbParse::Open(path, parse_options, &parse);
+      if (!s.ok()) {
+        return s;
+      }
+      while (parse->Valid()) {
+        uint64_t t = NowNanos();
+        s = parse->Next();
+        if (!s.ok()) {
+          break;
+        }
+        if (latency) {
+          latency->Add(NowNanos() - t);
+        }
+        *items += parse->Value()->key.empty() ? 0 : 1;
+      }
+      *bytes = stats.bytes;
+      if (parse->Stats()) {
+        stats_text = parse->Stats()->ToString();
+      }
+      delete parse;
+      return s;
+    });
+    if (bench->verbose && !stats_text.empty()) {
+      printf("%s", stats_text.c_str());
+    }
+  }
+  unlink(path.c_str());
+}
+
+// A few keys of many quicklist nodes, decoded on one thread and on the
+// decode pool.
+static void BenchBigQuicklists(Bench *bench) {
+  GeneratorOptions options;
+  options.seed = bench->seed;
+  options.target_bytes = bench->corpus_bytes;
+  options.elements_dist = kSizeFixed;
+  options.elements_mean = 1 << 18;
+  options.elements_max = 1 << 18;
+  options.node_entries = 128;
+  options.SetTypeWeights("quicklist=1");
+  std::string path = bench->TempPath("big_quicklists");
+  GeneratorStats stats;
+  Status s = RdbGenerator(options).Generate(path, &stats);
+  if (!s.ok()) {
+    bench->Fail("e2e_big_quicklists", s);
+    return;
+  }
+  static const char *kModes[] = {"e2e_big_quicklists", "e2e_big_quicklists_parallel"};
+  for (int mode = 0; mode < 2; mode++) {
+    if (!bench->Selected(kModes[mode])) {
+      continue;
+    }
+    ParseOptions parse_options;
+    parse_options.decode_threads = mode == 0 ? 1 : 0;
+    bench->RunCounted(kModes[mode], [&](Latency *latency, uint64_t *bytes,
+          uint64_t *items) {
+      // a few keys per round, so the round is the latency sample
+      uint64_t t = NowNanos();
+      RdbParse *parse;
+      Status s = RdbParse::Open(path, parse_options, &parse);
+      if (!s.ok()) {
+        return s;
+      }
+      while (s.ok() && parse->Valid()) {
+        s = parse->Next();
+        if (s.ok()) {
+          *items += parse->Value()->list_value.size();
+        }
+      }
+      if (latency && *items) {
+        latency->Add(double(NowNanos() - t) / *items);
+      }
+      *bytes = stats.bytes;
+      delete parse;
+      return s;
+    });
+  }
+  unlink(path.c_str());
+}
+
+static Status WriteJson(const std::string &path, const std::vector<BenchResult> &results) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    return Status::IOError(path, strerror(errno));
+  }
+  fprintf(f, "{\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &r = results[i];
+    // one benchmark per line, ReadBaseline depends on it
+    fprintf(f, "    {\"name\": \"%s\", \"mb_per_s\": %.3f, \"items_per_s\": %.1f, "
+        "\"allocs_per_item\": %.3f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, "
+        "\"bytes\": %lu, \"items\": %lu, \"secs\": %.3f}%s\n", r.name.c_str(),
+        r.MBps(), r.ItemsPerSec(), r.AllocsPerItem(), r.p50_ns, r.p99_ns,
+        r.bytes, r.items, r.secs, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  return fclose(f) == 0 ? Status::OK() : Status::IOError(path, strerror(errno));
+}
+
+static Status ReadBaseline(const std::string &path, std::map<std::string, double> *mbps) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL) {
+    return Status::IOError(path, strerror(errno));
+  }
+  char line[1024], name[256];
+  double v;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, " {\"name\": \"%255[^\"]\", \"mb_per_s\": %lf", name, &v) == 2) {
+      (*mbps)[name] = v;
+    }
+  }
+  fclose(f);
+  return Status::OK();
+}
+
+int main(int argc, char* argv[]) {
+  Bench bench;
+  std::string json_path, baseline_path;
+  double max_regression = 10;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:f:d:S:o:b:r:v")) != -1) {
+    switch (opt) {
+      case 's': bench.corpus_bytes = ParseSize(optarg); break;
+      case 't': bench.min_secs = atof(optarg); break;
+      case 'f': bench.filter = optarg; break;
+      case 'd': bench.dir = optarg; break;
+      case 'S': bench.seed = strtoull(optarg, NULL, 10); break;
+      case 'o': json_path = optarg; break;
+      case 'b': baseline_path = optarg; break;
+      case 'r': max_regression = atof(optarg); break;
+      case 'v': bench.verbose = true; break;
+      default: PrintHelp(); return 1;
+    }
+  }
+
+  static const struct {
+    const char *name;
+    void (*run)(Bench *);
+  } kMicro[] = {
+    {"load_length", BenchLoadLength},
+    {"load_string", BenchLoadString},
+    {"lzf_decompress", BenchLzf},
+    {"crc64", BenchCrc64},
+    {"ziplist", BenchZiplist},
+    {"zipmap", BenchZipmap},
+    {"intset_get_all", BenchIntset},
+    {"numeric", BenchNumeric},
+  };
+  for (size_t i = 0; i < sizeof(kMicro) / sizeof(kMicro[0]); i++) {
+    if (bench.Selected(kMicro[i].name)) {
+      kMicro[i].run(&bench);
+    }
+  }
+  static const char *kCorpora[][2] = {
+    {"mixed", ""},
+    {"strings", "string=1"},
+    {"collections", "list=1,set=1,hash=1,zset2=1,intset=2,list_ziplist=2,"
+      "zset_ziplist=2,hash_ziplist=4,quicklist=2"},
+  };
+  for (size_t i = 0; i < sizeof(kCorpora) / sizeof(kCorpora[0]); i++) {
+    std::string name = std::string("e2e_") + kCorpora[i][0];
+    if (bench.Selected(name) || bench.Selected(name + "_skip")) {
+      BenchEndToEnd(&bench, kCorpora[i][0], kCorpora[i][1]);
+    }
+  }
+  if (bench.Selected("e2e_big_quicklists")
+      || bench.Selected("e2e_big_quicklists_parallel")) {
+    BenchBigQuicklists(&bench);
+  }
+
+  if (!json_path.empty()) {
+    Status s = WriteJson(json_path, bench.results);
+    if (!s.ok()) {
+      std::cout << s.ToString() << std::endl;
+      return 1;
+    }
+  }
+  int regressions = 0;
+  if (!baseline_path.empty()) {
+    std::map<std::string, double> baseline;
+    Status s = ReadBaseline(baseline_path, &baseline);
+    if (!s.ok()) {
+      std::cout << s.ToString() << std::endl;
+      return 1;
+    }
+    printf("\ncompared with %s:\n", baseline_path.c_str());
+    for (const BenchResult &r : bench.results) {
+      auto it = baseline.find(r.name);
+      if (it == baseline.end() || it->second <= 0) {
+        continue;
+      }
+      double delta = (r.MBps() - it->second) * 100 / it->second;
+      bool regressed = delta < -max_regression;
+      regressions += regressed ? 1 : 0;
+      printf("%-28s %10.1f -> %10.1f MB/s %+7.1f%%%s\n", r.name.c_str(),
+          it->second, r.MBps(), delta, regressed ? "  REGRESSION" : "");
+    }
+  }
+  if (bench.mismatches) {
+    printf("%lu numeric results differ from libc\n", bench.mismatches);
+    return 1;
+  }
+  if (bench.failures) {
+    printf("%lu benchmarks failed\n", bench.failures);
+    return 1;
+  }
+  return regressions ? 2 : 0;
+}
@@ -0,0 +1,58 @@
+// Parses several rdb files at once, e.g. the dumps of every master of a
+// cluster, and prints their records like parse_test does.
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include "include/multi_rdb_parse.h"
+
+void PrintHelp() {
+  printf("./multi_parse [-t threads] [-o] [-m buffer_mb] [-s] rdbfile.rdb...\n"
+      "  -o  print the files one after the other instead of interleaved\n"
+      "  -s  prefix every record with the index of its file\n");
+}
+
+using namespace parser;
+int main(int argc, char* argv[]) {
+  MultiParseOptions options;
+  bool show_source = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:om:s")) != -1) {
+    switch (opt) {
+      case 't': options.threads = atoi(optarg); break;
+      case 'o': options.file_order = true; break;
+      case 'm': options.max_buffered_bytes = strtoull(optarg, NULL, 10) << 20; break;
+      case 's': show_source = true; break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 1) {
+    PrintHelp();
+    return 1;
+  }
+  std::vector<std::string> paths(argv + optind, argv + argc);
+  MultiRdbParse *parse;
+  Status s = MultiRdbParse::Open(paths, options, &parse);
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    return 1;
+  }
+  int failed = 0;
+  while (parse->Valid()) {
+    s = parse->Next();
+    if (!s.ok()) {
+      std::cout << "Failed:" << parse->SourcePath() << ": " << s.ToString() << std::endl;
+      failed++;
+      continue;
+    }
+    if (!parse->Valid()) {
+      break;
+    }
+    if (show_source) {
+      printf("%zu ", parse->SourceIndex());
+    }
+    parse->Value()->Debug();
+  }
+  delete parse;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+// Feeds an rdb file to RdbPushParser in chunks of random size and prints
+// the records like parse_test does, to check both parsers agree.
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include "include/rdb_push_parser.h"
+
+void PrintHelp() {
+  printf("./push_parse [-c max_chunk] [-S seed] rdbfile.rdb\n");
+}
+
+using namespace parser;
+int main(int argc, char* argv[]) {
+  size_t max_chunk = 4096;
+  unsigned seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "c:S:")) != -1) {
+    switch (opt) {
+      case 'c': max_chunk = strtoul(optarg, NULL, 10); break;
+      case 'S': seed = strtoul(optarg, NULL, 10); break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 1 || max_chunk == 0) {
+    PrintHelp();
+    return 1;
+  }
+  FILE *f = fopen(argv[optind], "r");
+  if (f == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  srand(seed);
+  RdbPushParser parser;
+  std::vector<ParsedResult> records;
+  std::vector<char> chunk(max_chunk);
+  uint64_t max_buffered = 0;
+  Status s;
+  while (s.ok()) {
+    size_t n = fread(&chunk[0], 1, 1 + rand() % max_chunk, f);
+    s = n ? parser.Feed(&chunk[0], n, &records) : parser.Finish(&records);
+    for (ParsedResult &r : records) {
+      r.Debug();
+    }
+    records.clear();
+    max_buffered = std::max(max_buffered, parser.buffered());
+    if (n == 0) {
+      break;
+    }
+  }
+  fclose(f);
+  if (!s.ok()) {
+    std::cout << "Failed:" << s.ToString() << std::endl;
+    return 1;
+  }
+  fprintf(stderr, "done: %d, max buffered: %lu\n", parser.Done(), max_buffered);
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <iostream>
+#include "src/rdb_generator.h"
+
+void PrintHelp() {
+  printf("./rdb_gen [options] out.rdb\n"
+      "  -s bytes    stop at this file size, K/M/G suffixes allowed (64M)\n"
+      "  -n keys     stop after this many keys\n"
+      "  -v version  rdb version (9)\n"
+      "  -S seed     random seed (1)\n"
+      "  -d dbs      number of databases (1)\n"
+      "  -t weights  type mix as name=weight,... e.g. string=4,hash_ziplist=1\n"
+      "  -z dist     value size as fixed:mean, uniform:min:max or exp:min:mean:max\n"
+      "  -e dist     elements per collection, same format as -z\n"
+      "  -N entries  entries per quicklist node and stream listpack (64)\n"
+      "  -c ratio    compressibility of values, 0 to 1 (0.5)\n"
+      "  -i ratio    share of integer values (0.2)\n"
+      "  -x ratio    share of keys with a ttl (0.3)\n"
+      "  -X ratio    share of ttls already expired (0.3)\n"
+      "  -L          do not LZF compress strings\n");
+}
+
+using namespace parser;
+
+static bool ParseDist(const char *arg, SizeDistribution *dist, uint32_t *min,
+    uint32_t *mean, uint32_t *max) {
+  unsigned a, b, c;
+  if (sscanf(arg, "fixed:%u", &a) == 1) {
+    *dist = kSizeFixed;
+    *min = *mean = *max = a;
+  } else if (sscanf(arg, "uniform:%u:%u", &a, &b) == 2) {
+    *dist = kSizeUniform;
+    *min = a;
+    *max = b;
+    *mean = (a + b) / 2;
+  } else if (sscanf(arg, "exp:%u:%u:%u", &a, &b, &c) == 3) {
+    *dist = kSizeExponential;
+    *min = a;
+    *mean = b;
+    *max = c;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  GeneratorOptions options;
+  int opt;
+  bool ok = true, size_given = false;
+  while (ok && (opt = getopt(argc, argv, "s:n:v:S:d:t:z:e:N:c:i:x:X:L")) != -1) {
+    switch (opt) {
+      case 's':
+        options.target_bytes = ParseSize(optarg);
+        size_given = true;
+        break;
+      case 'n': options.max_keys = strtoull(optarg, NULL, 10); break;
+      case 'v': options.rdb_version = atoi(optarg); break;
+      case 'S': options.seed = strtoull(optarg, NULL, 10); break;
+      case 'd': options.databases = atoi(optarg); break;
+      case 't': ok = options.SetTypeWeights(optarg).ok(); break;
+      case 'z':
+        ok = ParseDist(optarg, &options.size_dist, &options.size_min,
+            &options.size_mean, &options.size_max);
+        break;
+      case 'e':
+        ok = ParseDist(optarg, &options.elements_dist, &options.elements_min,
+            &options.elements_mean, &options.elements_max);
+        break;
+      case 'N': options.node_entries = atoi(optarg); break;
+      case 'c': options.compressibility = atof(optarg); break;
+      case 'i': options.int_ratio = atof(optarg); break;
+      case 'x': options.expire_ratio = atof(optarg); break;
+      case 'X': options.expired_ratio = atof(optarg); break;
+      case 'L': options.compress = false; break;
+      default: ok = false; break;
+    }
+  }
+  if (!ok || argc - optind < 1) {
+    PrintHelp();
+    return 1;
+  }
+  // -n alone means no size limit
+  if (options.max_keys && !size_given) {
+    options.target_bytes = 0;
+  }
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  GeneratorStats stats;
+  RdbGenerator generator(options);
+  Status s = generator.Generate(argv[optind], &stats);
+  gettimeofday(&end, NULL);
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    return 1;
+  }
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("keys: %lu, bytes: %lu, elements: %lu, expires: %lu, expired: %lu, "
+      "%.3fs, %.1f MB/s\n", stats.keys, stats.bytes, stats.elements,
+      stats.expires, stats.expired, secs,
+      secs > 0 ? stats.bytes / secs / (1 << 20) : 0);
+  for (int i = 0; i < kGeneratorTypes; i++) {
+    if (stats.keys_per_type[i]) {
+      printf("  %-14s %lu\n", GeneratorTypeName(i), stats.keys_per_type[i]);
+    }
+  }
+  return 0;
+}
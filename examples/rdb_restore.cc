@@ -0,0 +1,155 @@
+#include <getopt.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <iostream>
+#include "include/rdbparse.h"
+#include "include/parse_checkpoint.h"
+#include "include/resp_exporter.h"
+#include "include/trace.h"
+
+void PrintHelp() {
+  printf("./rdb_restore [-c connections] [-w window] [-b batch] [-a password] [-r] [-R] "
+      "[-p] [-P textfile] [-T trace.json] [-F] [-C checkpoint] [-k chunk_bytes] "
+      "rdbfile.rdb host port\n"
+      "  -p  print progress to stderr every second\n"
+      "  -P  write progress in Prometheus text format to the file\n"
+      "  -T  write a Chrome trace of the decode, needs a library built with "
+      "ENABLE_TRACE=1\n"
+      "  -F  follow a file still being written by BGSAVE until its EOF\n"
+      "  -C  save progress to the file every 10s, and resume from it when it\n"
+      "      exists; it is removed once the restore succeeded\n"
+      "  -k  send values bigger than chunk_bytes in parts, not with -R\n");
+}
+
+static double NowSecs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+using namespace parser;
+int main(int argc, char* argv[]) {
+  RespExporterOptions options;
+  ParseOptions parse_options;
+  bool restore = false;
+  std::string trace_path;
+  std::string checkpoint_path;
+  RespExporter *exporter = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "c:w:b:a:rRpP:T:FC:k:")) != -1) {
+    switch (opt) {
+      case 'c': options.connections = atoi(optarg); break;
+      case 'w': options.pipeline_window = atoi(optarg); break;
+      case 'b': options.batch_elements = atoi(optarg); break;
+      case 'a': options.password = optarg; break;
+      case 'r': options.replace = true; break;
+      case 'R': restore = true; break;
+      case 'p':
+        parse_options.progress = [](const ParseProgress &p) {
+          fprintf(stderr, "%.1f/%.1f MB, %lu keys, %.1f MB/s, %.0f keys/s, eta %.0fs\n",
+              p.offset / 1048576.0, p.total_bytes / 1048576.0, p.keys,
+              p.bytes_per_sec / 1048576.0, p.keys_per_sec, p.eta_secs);
+        };
+        break;
+      case 'P': parse_options.progress_textfile = optarg; break;
+      case 'T': trace_path = optarg; break;
+      case 'F': parse_options.follow = true; break;
+      case 'C': checkpoint_path = optarg; break;
+      case 'k':
+        parse_options.chunk_bytes = strtoull(optarg, NULL, 10);
+        parse_options.value_chunk = [&exporter](const ParsedResult &part) {
+          return exporter->Append(part);
+        };
+        break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 3) {
+    PrintHelp();
+    return 1;
+  }
+  std::string rdb_path(argv[optind]);
+  RdbParse *parse;
+  // RESTORE replays the encoded values untouched, no need to decode them
+  parse_options.capture_raw = restore;
+  parse_options.decode_value = !restore;
+  ParseCheckpoint checkpoint;
+  Status s = checkpoint_path.empty() ? Status::NotFound("no checkpoint")
+    : ReadCheckpoint(checkpoint_path, &checkpoint);
+  if (s.ok()) {
+    fprintf(stderr, "resuming at offset %lu after %lu keys\n", checkpoint.offset,
+        checkpoint.keys);
+    s = RdbParse::Open(rdb_path, checkpoint, parse_options, &parse);
+  } else if (s.IsNotFound()) {
+    s = RdbParse::Open(rdb_path, parse_options, &parse);
+  }
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    return 1;
+  }
+  s = RespExporter::Open(argv[optind + 1], atoi(argv[optind + 2]), options, &exporter);
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    delete parse;
+    return 1;
+  }
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  uint64_t keys = 0;
+  double next_checkpoint = NowSecs() + 10;
+  while (s.ok() && parse->Valid()) {
+    // the exporter pipelines commands, only a flushed state is safe to save
+    if (!checkpoint_path.empty() && (keys & 1023) == 0 && NowSecs() >= next_checkpoint) {
+      s = exporter->Flush();
+      if (s.ok() && parse->GetCheckpoint(&checkpoint).ok()) {
+        s = WriteCheckpoint(checkpoint_path, checkpoint);
+      }
+      next_checkpoint = NowSecs() + 10;
+      if (!s.ok()) {
+        break;
+      }
+    }
+    s = parse->Next();
+    if (!s.ok()) {
+      std::cout << "Failed:" << s.ToString() << std::endl;
+      break;
+    }
+    ParsedResult *value = parse->Value();
+    if (value->key.empty()) {
+      continue;
+    }
+    s = restore ? exporter->AppendRestore(*value, parse->Version())
+      : exporter->Append(*value);
+    keys++;
+  }
+  if (s.ok()) {
+    s = exporter->Flush();
+  }
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("keys: %lu, commands: %lu, replies: %lu, errors: %lu, skipped: %lu, "
+      "%.3fs, %.0f commands/s\n", keys, exporter->commands(), exporter->replies(),
+      exporter->errors(), exporter->skipped(), secs,
+      secs > 0 ? exporter->commands() / secs : 0);
+  if (!exporter->first_error().empty()) {
+    printf("first error: %s\n", exporter->first_error().c_str());
+  }
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+  }
+  if (!trace_path.empty()) {
+    Status ts = TraceExportChrome(trace_path);
+    if (!ts.ok()) {
+      std::cout << ts.ToString() << std::endl;
+    }
+  }
+  bool ok = s.ok() && exporter->errors() == 0;
+  if (ok && !checkpoint_path.empty()) {
+    unlink(checkpoint_path.c_str());
+  }
+  delete exporter;
+  delete parse;
+  return ok ? 0 : 1;
+}
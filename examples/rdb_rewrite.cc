@@ -0,0 +1,110 @@
+#include <getopt.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <iostream>
+#include <set>
+#include <vector>
+#include "include/rdbparse.h"
+#include "include/rdb_writer.h"
+
+void PrintHelp() {
+  printf("./rdb_rewrite [-p key_prefix]... [-d db]... [-x] in.rdb out.rdb\n"
+      "  -p  keep keys starting with the prefix\n"
+      "  -d  keep keys of the db\n"
+      "  -x  drop keys already expired now\n");
+}
+
+using namespace parser;
+int main(int argc, char* argv[]) {
+  std::vector<std::string> prefixes;
+  std::set<uint32_t> dbs;
+  bool drop_expired = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:d:x")) != -1) {
+    switch (opt) {
+      case 'p': prefixes.push_back(optarg); break;
+      case 'd': dbs.insert(atoi(optarg)); break;
+      case 'x': drop_expired = true; break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 2) {
+    PrintHelp();
+    return 1;
+  }
+
+  // entries are copied from their encoded bytes, never decoded
+  ParseOptions parse_options;
+  parse_options.capture_raw = true;
+  parse_options.decode_value = false;
+  if (drop_expired) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    parse_options.expired_as_of_ms = now.tv_sec * 1000LL + now.tv_usec / 1000;
+  }
+  RdbParse *parse;
+  Status s = RdbParse::Open(argv[optind], parse_options, &parse);
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    return 1;
+  }
+  RdbWriter *writer;
+  s = RdbWriter::Open(argv[optind + 1], RdbWriterOptions(), &writer);
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    delete parse;
+    return 1;
+  }
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  uint64_t keys = 0, kept = 0;
+  bool header = false;
+  while (s.ok() && parse->Valid()) {
+    s = parse->Next();
+    if (!s.ok()) {
+      break;
+    }
+    if (!header) {
+      // every aux field precedes the first key
+      s = writer->WriteHeader(parse->Version());
+      for (const AuxKV &aux : parse->AuxFields()) {
+        if (s.ok()) {
+          s = writer->WriteAux(aux.aux_key, aux.aux_val);
+        }
+      }
+      header = true;
+    }
+    ParsedResult *value = parse->Value();
+    if (value->key.empty()) {
+      continue;
+    }
+    keys++;
+    if (!dbs.empty() && !dbs.count(value->db_num)) {
+      continue;
+    }
+    bool match = prefixes.empty();
+    for (size_t i = 0; i < prefixes.size() && !match; i++) {
+      match = value->key.compare(0, prefixes[i].size(), prefixes[i]) == 0;
+    }
+    if (!match) {
+      continue;
+    }
+    s = writer->WriteEntry(*value);
+    kept++;
+  }
+  if (s.ok()) {
+    s = writer->Finish();
+  }
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("keys: %lu, kept: %lu, written: %lu bytes, %.3fs, %.1f MB/s\n", keys, kept,
+      writer->bytes_written(), secs,
+      secs > 0 ? writer->bytes_written() / secs / (1 << 20) : 0);
+  if (!s.ok()) {
+    std::cout << "Failed:" << s.ToString() << std::endl;
+  }
+  delete writer;
+  delete parse;
+  return s.ok() ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+// A stand-in master that answers the replica handshake, streams a fixture
+// rdb file as a full resync and then a fixture command stream, to test the
+// replication source without a Redis server. One replica is served at a
+// time; the link is closed once it acknowledged the whole stream.
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+void PrintHelp() {
+  printf("./repl_fixture_server [-e] [-b chunk] [-c commands.txt] port rdbfile.rdb\n"
+      "  -e  diskless framing, $EOF:<mark> instead of $<len>\n"
+      "  -b  write the snapshot in chunks of that many bytes\n"
+      "  -c  commands to propagate after the snapshot, one per line\n");
+}
+
+static std::string Command(const std::vector<std::string> &argv) {
+  std::string out = "*" + std::to_string(argv.size()) + "\r\n";
+  for (const std::string &a : argv) {
+    out += "$" + std::to_string(a.size()) + "\r\n" + a + "\r\n";
+  }
+  return out;
+}
+
+static bool WriteAll(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0 && errno == EINTR) {
+      continue;
+    }
+    if (w <= 0) {
+      return false;
+    }
+    p += w;
+    n -= w;
+  }
+  return true;
+}
+
+// Read one command of the replica, returns false once it hung up.
+static bool ReadCommand(int fd, std::string *buf, std::vector<std::string> *argv) {
+  while (true) {
+    argv->clear();
+    size_t pos = 0;
+    bool complete = false;
+    size_t eol = buf->find("\r\n");
+    if (eol != std::string::npos && (*buf)[0] == '*') {
+      long argc = strtol(buf->c_str() + 1, NULL, 10);
+      pos = eol + 2;
+      complete = true;
+      for (long i = 0; i < argc && complete; i++) {
+        eol = buf->find("\r\n", pos);
+        if (eol == std::string::npos) {
+          complete = false;
+          break;
+        }
+        size_t len = strtoul(buf->c_str() + pos + 1, NULL, 10);
+        pos = eol + 2;
+        if (buf->size() < pos + len + 2) {
+          complete = false;
+          break;
+        }
+        argv->push_back(buf->substr(pos, len));
+        pos += len + 2;
+      }
+    }
+    if (complete) {
+      buf->erase(0, pos);
+      return true;
+    }
+    char tmp[4096];
+    ssize_t r = read(fd, tmp, sizeof(tmp));
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    buf->append(tmp, r);
+  }
+}
+
+static void Serve(int fd, const std::string &rdb, const std::string &stream,
+    bool diskless, size_t chunk) {
+  std::string buf;
+  std::vector<std::string> argv;
+  bool psync = false;
+  while (ReadCommand(fd, &buf, &argv) && !argv.empty()) {
+    if (strcasecmp(argv[0].c_str(), "PSYNC") == 0) {
+      psync = true;
+      break;
+    }
+    if (strcasecmp(argv[0].c_str(), "SYNC") == 0) {
+      break;
+    }
+    fprintf(stderr, "handshake: %s\n", argv[0].c_str());
+    if (!WriteAll(fd, "+OK\r\n", 5)) {
+      return;
+    }
+  }
+  if (argv.empty()) {
+    return;
+  }
+  std::string mark(40, 'x');
+  for (size_t i = 0; i < mark.size(); i++) {
+    mark[i] = "0123456789abcdef"[rand() % 16];
+  }
+  std::string head;
+  if (psync) {
+    head = "+FULLRESYNC " + mark + " 0\r\n";
+  }
+  // newlines sent while the snapshot is produced
+  head += "\n\n";
+  head += diskless ? "$EOF:" + mark + "\r\n" : "$" + std::to_string(rdb.size()) + "\r\n";
+  if (!WriteAll(fd, head.data(), head.size())) {
+    return;
+  }
+  for (size_t pos = 0; pos < rdb.size(); pos += chunk) {
+    if (!WriteAll(fd, rdb.data() + pos, std::min(chunk, rdb.size() - pos))) {
+      return;
+    }
+  }
+  if (diskless && !WriteAll(fd, mark.data(), mark.size())) {
+    return;
+  }
+  if (!psync) {
+    WriteAll(fd, stream.data(), stream.size());
+    return;
+  }
+  // like a diskless master, wait for the first ACK before streaming
+  if (!ReadCommand(fd, &buf, &argv) || argv.size() < 3) {
+    return;
+  }
+  fprintf(stderr, "ack after snapshot: %s\n", argv[2].c_str());
+  if (!WriteAll(fd, stream.data(), stream.size())) {
+    return;
+  }
+  std::string end = std::to_string(stream.size());
+  while (ReadCommand(fd, &buf, &argv)) {
+    if (argv.size() == 3 && argv[2] == end) {
+      fprintf(stderr, "acked offset: %s\n", end.c_str());
+      return;
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  bool diskless = false;
+  size_t chunk = 16 * 1024;
+  const char *commands_path = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "eb:c:")) != -1) {
+    switch (opt) {
+      case 'e': diskless = true; break;
+      case 'b': chunk = strtoul(optarg, NULL, 10); break;
+      case 'c': commands_path = optarg; break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 2 || chunk == 0) {
+    PrintHelp();
+    return 1;
+  }
+  int port = atoi(argv[optind]);
+  std::string rdb;
+  FILE *f = fopen(argv[optind + 1], "r");
+  if (f == NULL) {
+    perror(argv[optind + 1]);
+    return 1;
+  }
+  char tmp[64 * 1024];
+  size_t n;
+  while ((n = fread(tmp, 1, sizeof(tmp), f)) > 0) {
+    rdb.append(tmp, n);
+  }
+  fclose(f);
+
+  std::string stream;
+  if (commands_path) {
+    f = fopen(commands_path, "r");
+    if (f == NULL) {
+      perror(commands_path);
+      return 1;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+      std::vector<std::string> cmd;
+      for (char *tok = strtok(line, " \r\n"); tok; tok = strtok(NULL, " \r\n")) {
+        cmd.push_back(tok);
+      }
+      if (!cmd.empty()) {
+        stream += Command(cmd);
+      }
+    }
+    fclose(f);
+  }
+  stream += Command({"PING"});
+  stream += Command({"REPLCONF", "GETACK", "*"});
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int yes = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0) {
+    printf("listen failed: %s\n", strerror(errno));
+    return 1;
+  }
+  while (true) {
+    int cfd = accept(lfd, NULL, NULL);
+    if (cfd < 0) {
+      continue;
+    }
+    Serve(cfd, rdb, stream, diskless, chunk);
+    close(cfd);
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Syncs as a replica of a Redis compatible master, prints the snapshot
+// records like parse_test does and then, with -f, the propagated commands.
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include "include/rdb_replication.h"
+
+void PrintHelp() {
+  printf("./repl_parse [-a password] [-s] [-f] [-t timeout_ms] host port\n"
+      "  -s  plain SYNC instead of PSYNC\n"
+      "  -f  follow the command stream after the snapshot\n");
+}
+
+using namespace parser;
+int main(int argc, char* argv[]) {
+  ReplicationOptions options;
+  bool follow = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:sft:")) != -1) {
+    switch (opt) {
+      case 'a': options.password = optarg; break;
+      case 's': options.psync = false; break;
+      case 'f': follow = true; break;
+      case 't': options.timeout_ms = atoi(optarg); break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 2) {
+    PrintHelp();
+    return 1;
+  }
+  ReplicationSource *source;
+  Status s = ReplicationSource::Open(argv[optind], atoi(argv[optind + 1]),
+      options, &source);
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    return 1;
+  }
+  s = source->ReadSnapshot([](ParsedResult *r) {
+    r->Debug();
+    return Status::OK();
+  });
+  fprintf(stderr, "snapshot: %lu bytes, replid %s, offset %ld\n",
+      source->snapshot_bytes(), source->replid().c_str(), source->offset());
+  if (s.ok() && follow) {
+    uint64_t commands = 0;
+    s = source->ReadCommands([&](const std::vector<std::string> &cmd) {
+      std::cout << "command:";
+      for (const std::string &arg : cmd) {
+        std::cout << " " << arg;
+      }
+      std::cout << std::endl;
+      commands++;
+      return Status::OK();
+    });
+    fprintf(stderr, "commands: %lu, offset %ld\n", commands, source->offset());
+    if (s.IsEndFile()) {
+      s = Status::OK();
+    }
+  }
+  delete source;
+  if (!s.ok()) {
+    std::cout << "Failed:" << s.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,160 @@
+// A stand-in RESP server that acknowledges every command with +OK, used to
+// test and benchmark the restore pipeline without a real target.
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+void PrintHelp() {
+  printf("./resp_ack_server port\n");
+}
+
+struct Client {
+  int fd;
+  std::string rbuf;
+  std::string wbuf;
+};
+
+static uint64_t NowMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static long FindLine(const char *p, size_t n, size_t from) {
+  const char *eol = from < n ?
+    static_cast<const char *>(memchr(p + from, '\n', n - from)) : NULL;
+  return eol ? eol - p - 1 : -1;
+}
+
+// Returns the size of the command at the head of |p|, 0 if incomplete and
+// -1 on protocol error.
+static long CommandSize(const char *p, size_t n) {
+  long eol = FindLine(p, n, 0);
+  if (eol < 0) {
+    return 0;
+  }
+  if (p[0] != '*') {
+    return eol + 2;  // inline command
+  }
+  long argc = strtol(p + 1, NULL, 10);
+  size_t pos = eol + 2;
+  for (long i = 0; i < argc; i++) {
+    long e = FindLine(p, n, pos);
+    if (e < 0) {
+      return 0;
+    }
+    if (p[pos] != '$') {
+      return -1;
+    }
+    long len = strtol(p + pos + 1, NULL, 10);
+    pos = e + 2 + len + 2;
+    if (pos > n) {
+      return 0;
+    }
+  }
+  return pos;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintHelp();
+    return 1;
+  }
+  int port = atoi(argv[1]);
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int yes = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 128) < 0) {
+    printf("listen failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  std::vector<Client> clients;
+  uint64_t commands = 0, bytes = 0, last_commands = 0;
+  uint64_t last_report = NowMicros();
+  while (true) {
+    std::vector<struct pollfd> fds(clients.size() + 1);
+    fds[0].fd = lfd;
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < clients.size(); i++) {
+      fds[i + 1].fd = clients[i].fd;
+      fds[i + 1].events = POLLIN | (clients[i].wbuf.empty() ? 0 : POLLOUT);
+    }
+    if (poll(&fds[0], fds.size(), 1000) < 0 && errno != EINTR) {
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      int cfd = accept(lfd, NULL, NULL);
+      if (cfd >= 0) {
+        fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+        clients.push_back(Client{cfd, std::string(), std::string()});
+      }
+    }
+    for (size_t i = 0; i + 1 < fds.size(); i++) {
+      Client &c = clients[i];
+      bool closed = false;
+      if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+        char buf[64 * 1024];
+        ssize_t r = read(c.fd, buf, sizeof(buf));
+        if (r <= 0 && !(r < 0 && errno == EAGAIN)) {
+          closed = true;
+        } else if (r > 0) {
+          bytes += r;
+          c.rbuf.append(buf, r);
+          size_t pos = 0;
+          while (pos < c.rbuf.size()) {
+            long n = CommandSize(c.rbuf.data() + pos, c.rbuf.size() - pos);
+            if (n <= 0) {
+              closed = n < 0;
+              break;
+            }
+            pos += n;
+            commands++;
+            c.wbuf.append("+OK\r\n");
+          }
+          c.rbuf.erase(0, pos);
+        }
+      }
+      if (!closed && !c.wbuf.empty()) {
+        ssize_t w = write(c.fd, c.wbuf.data(), c.wbuf.size());
+        if (w > 0) {
+          c.wbuf.erase(0, w);
+        } else if (w < 0 && errno != EAGAIN) {
+          closed = true;
+        }
+      }
+      if (closed) {
+        close(c.fd);
+        c.fd = -1;
+      }
+    }
+    for (size_t i = clients.size(); i > 0; i--) {
+      if (clients[i - 1].fd < 0) {
+        clients.erase(clients.begin() + i - 1);
+      }
+    }
+    uint64_t now = NowMicros();
+    if (now - last_report >= 1000000 && commands != last_commands) {
+      printf("commands: %lu, bytes: %lu, commands/s: %.0f\n", commands, bytes,
+          (commands - last_commands) * 1e6 / (now - last_report));
+      fflush(stdout);
+      last_commands = commands;
+      last_report = now;
+    }
+  }
+  return 0;
+}
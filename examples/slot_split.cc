@@ -0,0 +1,103 @@
+// Splits an rdb file by cluster hash slot, either evenly over N outputs
+// like the masters of a fresh cluster or into explicit slot ranges.
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <iostream>
+#include "include/slot_splitter.h"
+
+void PrintHelp() {
+  printf("./slot_split [-n outputs] [-o first-last[,first-last...]=path]... [-R] [-r] "
+      "in.rdb [out_prefix]\n"
+      "  -n  split the slots evenly into out_prefix.<i>.rdb (or .resp)\n"
+      "  -o  write the keys of the slot ranges to path\n"
+      "  -R  write RESTORE commands for redis-cli --pipe instead of rdb files\n"
+      "  -r  with -R, RESTORE with REPLACE\n");
+}
+
+using namespace parser;
+
+static bool ParseRanges(const std::string &spec, std::vector<SlotRange> *ranges) {
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    size_t comma = spec.find(',', pos);
+    std::string range = spec.substr(pos, comma == std::string::npos ? std::string::npos
+        : comma - pos);
+    char *end;
+    long first = strtol(range.c_str(), &end, 10);
+    long last = *end == '-' ? strtol(end + 1, &end, 10) : first;
+    if (*end != '\0' || first < 0 || last < first || last >= kClusterSlots) {
+      return false;
+    }
+    ranges->push_back(SlotRange(first, last));
+    if (comma == std::string::npos) {
+      break;
+    }
+    pos = comma + 1;
+  }
+  return !ranges->empty();
+}
+
+int main(int argc, char* argv[]) {
+  int outputs = 0;
+  std::vector<std::string> specs;
+  bool resp = false, replace = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:o:Rr")) != -1) {
+    switch (opt) {
+      case 'n': outputs = atoi(optarg); break;
+      case 'o': specs.push_back(optarg); break;
+      case 'R': resp = true; break;
+      case 'r': replace = true; break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 1 || (outputs > 0 && argc - optind < 2)
+      || (outputs <= 0 && specs.empty())) {
+    PrintHelp();
+    return 1;
+  }
+
+  SlotSplitter splitter;
+  Status s;
+  for (int i = 0; s.ok() && i < outputs; i++) {
+    std::vector<SlotRange> ranges{SlotRange(kClusterSlots * i / outputs,
+        kClusterSlots * (i + 1) / outputs - 1)};
+    std::string path = std::string(argv[optind + 1]) + "." + std::to_string(i)
+      + (resp ? ".resp" : ".rdb");
+    s = resp ? splitter.AddRespOutput(path, ranges, replace)
+      : splitter.AddRdbOutput(path, ranges);
+  }
+  for (size_t i = 0; s.ok() && i < specs.size(); i++) {
+    size_t eq = specs[i].find('=');
+    std::vector<SlotRange> ranges;
+    if (eq == std::string::npos || !ParseRanges(specs[i].substr(0, eq), &ranges)) {
+      std::cout << "bad output " << specs[i] << std::endl;
+      return 1;
+    }
+    std::string path = specs[i].substr(eq + 1);
+    s = resp ? splitter.AddRespOutput(path, ranges, replace)
+      : splitter.AddRdbOutput(path, ranges);
+  }
+  if (!s.ok()) {
+    std::cout << s.ToString() << std::endl;
+    return 1;
+  }
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  s = splitter.Split(argv[optind]);
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("keys: %lu, dropped: %lu, %.3fs\n", splitter.keys(), splitter.dropped(), secs);
+  for (size_t i = 0; i < splitter.outputs(); i++) {
+    printf("output %zu: %lu keys\n", i, splitter.output_keys(i));
+  }
+  if (!s.ok()) {
+    std::cout << "Failed:" << s.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
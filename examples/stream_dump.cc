@@ -0,0 +1,129 @@
+// Dumps the entries and consumer groups of every stream in an rdb file,
+// as text or as commands to recreate them with redis-cli --pipe.
+#include <getopt.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "include/rdbparse.h"
+#include "include/resp_exporter.h"
+
+void PrintHelp() {
+  printf("./stream_dump [-R] [-g] rdbfile.rdb\n"
+      "  -R  write XADD, XSETID and XGROUP CREATE commands for redis-cli --pipe\n"
+      "  -g  print only the stream summaries and consumer groups\n");
+}
+
+using namespace parser;
+
+static void PrintBytes(const Slice &s) {
+  fwrite(s.data(), 1, s.size(), stdout);
+}
+
+int main(int argc, char* argv[]) {
+  bool resp = false, groups_only = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "Rg")) != -1) {
+    switch (opt) {
+      case 'R': resp = true; break;
+      case 'g': groups_only = true; break;
+      default: PrintHelp(); return 1;
+    }
+  }
+  if (argc - optind < 1) {
+    PrintHelp();
+    return 1;
+  }
+
+  uint64_t entries = 0;
+  uint32_t db_num = 0;
+  std::string out;
+  std::vector<Slice> argv_buf;
+  std::string id;
+  ParseOptions options;
+  if (!groups_only) {
+    options.stream_entry = [&](const Slice &key, const StreamEntry &entry) {
+      entries++;
+      id = entry.id.ToString();
+      if (resp) {
+        argv_buf.assign({"XADD", key, id});
+        for (const auto &f : entry.fields) {
+          argv_buf.push_back(f.first);
+          argv_buf.push_back(f.second);
+        }
+        RespEncoder::AppendCommand(argv_buf, &out);
+        fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+        return Status::OK();
+      }
+      PrintBytes(key);
+      printf(" %s", id.c_str());
+      for (const auto &f : entry.fields) {
+        putchar(' ');
+        PrintBytes(f.first);
+        putchar('=');
+        PrintBytes(f.second);
+      }
+      putchar('\n');
+      return Status::OK();
+    };
+  }
+  RdbParse *parse;
+  Status s = RdbParse::Open(argv[optind], options, &parse);
+  if (!s.ok()) {
+    std::cerr << s.ToString() << std::endl;
+    return 1;
+  }
+  uint64_t streams = 0, pending = 0;
+  while (s.ok() && parse->Valid()) {
+    s = parse->Next();
+    ParsedResult *r = parse->Value();
+    if (!s.ok() || r->type != "stream") {
+      continue;
+    }
+    streams++;
+    const StreamInfo &info = r->stream_value;
+    if (resp) {
+      if (r->db_num != db_num) {
+        std::string db = std::to_string(r->db_num);
+        RespEncoder::AppendCommand({"SELECT", db}, &out);
+        db_num = r->db_num;
+      }
+      std::string last = info.last_id.ToString();
+      RespEncoder::AppendCommand({"XSETID", r->key, last}, &out);
+      for (const StreamGroup &g : info.groups) {
+        std::string group_last = g.last_id.ToString();
+        RespEncoder::AppendCommand({"XGROUP", "CREATE", r->key, g.name, group_last,
+            "MKSTREAM"}, &out);
+        pending += g.pending.size();
+      }
+      fwrite(out.data(), 1, out.size(), stdout);
+      out.clear();
+      continue;
+    }
+    printf("# stream %s: %lu entries in %lu listpacks, last id %s, first id %s, "
+        "%lu added, %zu groups\n", r->key.c_str(), info.length, info.listpacks,
+        info.last_id.ToString().c_str(), info.first_id.ToString().c_str(),
+        info.entries_added, info.groups.size());
+    for (const StreamGroup &g : info.groups) {
+      printf("#   group %s: last id %s, entries read %ld, %zu pending\n",
+          g.name.c_str(), g.last_id.ToString().c_str(), g.entries_read,
+          g.pending.size());
+      for (const StreamConsumer &c : g.consumers) {
+        printf("#     consumer %s: seen %ld, %zu pending\n", c.name.c_str(),
+            c.seen_time_ms, c.pending.size());
+      }
+    }
+  }
+  delete parse;
+  if (!s.ok()) {
+    std::cerr << s.ToString() << std::endl;
+    return 1;
+  }
+  std::cerr << "streams: " << streams << ", entries: " << entries << std::endl;
+  if (pending) {
+    std::cerr << pending << " pending entries not restored, they need XCLAIM"
+      << std::endl;
+  }
+  return 0;
+}
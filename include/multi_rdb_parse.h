@@ -0,0 +1,51 @@
+#ifndef __MULTI_RDB_PARSE_H__
+#define __MULTI_RDB_PARSE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "status.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+struct MultiParseOptions {
+  MultiParseOptions()
+    : threads(0), file_order(false), max_buffered_bytes(256 << 20) {}
+  // applied to every file, except that decode_threads and
+  // decompress_threads size one pool shared by all files. checkpoint_path
+  // is not supported.
+  ParseOptions parse;
+  // files parsed at once, 0 for one per core
+  int threads;
+  // false hands out records as they are parsed, interleaving the files;
+  // true returns every record of paths[0], then of paths[1] and so on.
+  // Records of one file keep their order either way.
+  bool file_order;
+  // Decoded records waiting for the caller, over all files. Parsers block
+  // once it is reached, except the one of the file being returned in
+  // file_order mode.
+  uint64_t max_buffered_bytes;
+};
+
+// Parses many rdb files, e.g. one per master of a cluster, on a bounded
+// pool of threads and returns their records through one iterator.
+class MultiRdbParse {
+  public:
+    static Status Open(const std::vector<std::string> &paths,
+        const MultiParseOptions &options, MultiRdbParse **rdb);
+    virtual ~MultiRdbParse();
+
+    // Wait for the next record. A file failing to open or parse is
+    // reported here once, after its records read so far, with SourcePath()
+    // naming it; call Next again to go on with the other files.
+    virtual Status Next() = 0;
+    virtual bool Valid() = 0;
+    virtual ParsedResult *Value() = 0;
+    // index in paths of the file the current record or error comes from
+    virtual size_t SourceIndex() = 0;
+    virtual const std::string &SourcePath() = 0;
+};
+
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef __PARSE_CHECKPOINT_H__
+#define __PARSE_CHECKPOINT_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "status.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+// Parser state at an entry boundary, enough to resume the parse there
+// without reading the bytes before it.
+struct ParseCheckpoint {
+  ParseCheckpoint()
+    : version(0), offset(0), file_size(0), db_num(0), db_size(0),
+      expire_size(0), check_sum(0), check_sum_partial(false), keys(0) {}
+  int version;
+  // file offset of the next entry
+  uint64_t offset;
+  // size of the file when the checkpoint was taken, 0 if unknown; a
+  // resume against a file of another size is refused
+  uint64_t file_size;
+  uint32_t db_num;
+  uint32_t db_size;
+  uint32_t expire_size;
+  // crc64 of the bytes before offset, or of only the bytes that were not
+  // skipped when check_sum_partial is set; the trailing checksum is then
+  // not verified after a resume
+  uint64_t check_sum;
+  bool check_sum_partial;
+  // keys returned before offset
+  uint64_t keys;
+  std::vector<AuxKV> aux_fields;
+};
+
+// Replace |path| atomically with |checkpoint|, a small text file.
+Status WriteCheckpoint(const std::string &path, const ParseCheckpoint &checkpoint);
+Status ReadCheckpoint(const std::string &path, ParseCheckpoint *checkpoint);
+
+}
+#endif
@@ -0,0 +1,33 @@
+#ifndef __PARSE_PROGRESS_H__
+#define __PARSE_PROGRESS_H__
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include "status.h"
+
+namespace parser {
+
+struct ParseProgress {
+  std::string path;
+  uint64_t offset;
+  uint64_t total_bytes;
+  uint64_t keys;
+  double elapsed_secs;
+  // averages since the parse started
+  double bytes_per_sec;
+  double keys_per_sec;
+  // seconds left at the current rate, -1 while unknown
+  double eta_secs;
+  // set on the last report, once EOF was read
+  bool done;
+};
+
+typedef std::function<void(const ParseProgress &)> ProgressCallback;
+
+// Write |progress| to |path| in the Prometheus text format, for the node
+// exporter textfile collector. The file is replaced atomically.
+Status WritePrometheusTextfile(const std::string &path, const ParseProgress &progress);
+
+}
+#endif
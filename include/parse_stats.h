@@ -0,0 +1,62 @@
+#ifndef __PARSE_STATS_H__
+#define __PARSE_STATS_H__
+
+#include <stdint.h>
+#include <string>
+
+namespace parser {
+
+enum ParseTimer {
+  kTimerIo = 0,     // reads and skips the file buffer could not serve
+  kTimerCrc,        // checksum updates, in bulk
+  kTimerLzf,        // LZF decompression
+  kTimerZiplist,    // ziplist, listpack, zipmap and quicklist node decoding
+  kTimerIntset,     // intset decoding
+  kTimerBuild,      // inserting decoded elements into the result
+  kNumTimers
+};
+
+enum StringEncoding {
+  kStringRaw = 0,
+  kStringInt8,
+  kStringInt16,
+  kStringInt32,
+  kStringLzf,
+  kNumStringEncodings
+};
+
+// Counters kept while parsing when ParseOptions::collect_stats is set.
+// Counters are plain additions. Timers only read the clock for one call
+// out of ParseOptions::stats_sample_period and extrapolate from those.
+struct ParseStats {
+  static const int kMaxTypes = 32;
+
+  ParseStats() { Reset(); }
+  void Reset();
+  // Estimated nanoseconds spent in |timer| over all calls.
+  uint64_t TimerNanos(int timer) const;
+  static const char *TimerName(int timer);
+  std::string ToString() const;
+
+  uint64_t bytes_read;
+  uint64_t read_calls;
+  uint64_t skipped_bytes;
+  uint64_t checksum_bytes;
+  uint64_t lzf_bytes_in;
+  uint64_t lzf_bytes_out;
+  // read buffers and result elements allocated by the parser
+  uint64_t allocations;
+  uint64_t keys;
+  // dropped, see ParseOptions::expired_as_of_ms
+  uint64_t expired_keys;
+  // indexed by the value type byte, which also names the encoding
+  uint64_t keys_per_type[kMaxTypes];
+  uint64_t strings_per_encoding[kNumStringEncodings];
+
+  uint64_t timer_calls[kNumTimers];
+  uint64_t timer_samples[kNumTimers];
+  uint64_t timer_sampled_nanos[kNumTimers];
+};
+
+}
+#endif
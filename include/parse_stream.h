@@ -0,0 +1,79 @@
+#ifndef __PARSE_STREAM_H__
+#define __PARSE_STREAM_H__
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "status.h"
+#include "slice.h"
+
+namespace parser {
+
+struct StreamId {
+  StreamId() : ms(0), seq(0) {}
+  StreamId(uint64_t m, uint64_t s) : ms(m), seq(s) {}
+  uint64_t ms;
+  uint64_t seq;
+  // "<ms>-<seq>", as XADD takes it
+  std::string ToString() const {
+    return std::to_string(ms) + "-" + std::to_string(seq);
+  }
+};
+
+// One entry of a stream. The fields point into the parser's buffers and
+// are only valid during the callback; entries sharing the field names of
+// their listpack's master entry all point at the same bytes.
+struct StreamEntry {
+  StreamId id;
+  std::vector<std::pair<Slice, Slice> > fields;
+};
+
+struct StreamPendingEntry {
+  StreamPendingEntry() : delivery_time_ms(0), delivery_count(0) {}
+  StreamId id;
+  int64_t delivery_time_ms;
+  uint64_t delivery_count;
+};
+
+struct StreamConsumer {
+  StreamConsumer() : seen_time_ms(0), active_time_ms(-1) {}
+  std::string name;
+  int64_t seen_time_ms;
+  // -1 before rdb version 11
+  int64_t active_time_ms;
+  // ids of the group's pending entries owned by this consumer
+  std::vector<StreamId> pending;
+};
+
+struct StreamGroup {
+  StreamGroup() : entries_read(-1) {}
+  std::string name;
+  StreamId last_id;
+  // -1 before rdb version 10, or when redis lost track of it
+  int64_t entries_read;
+  std::vector<StreamPendingEntry> pending;
+  std::vector<StreamConsumer> consumers;
+};
+
+// Everything about a stream but its entries, which only go through the
+// StreamEntryCallback. The ids and entries_added are 0 before rdb
+// version 10.
+struct StreamInfo {
+  StreamInfo() : length(0), listpacks(0), entries_added(0) {}
+  uint64_t length;
+  uint64_t listpacks;
+  StreamId last_id;
+  StreamId first_id;
+  StreamId max_deleted_id;
+  uint64_t entries_added;
+  std::vector<StreamGroup> groups;
+};
+
+// Called for every entry of a stream key, in id order, as it is decoded.
+// A status other than OK aborts the parse with it.
+typedef std::function<Status(const Slice &key, const StreamEntry &entry)> StreamEntryCallback;
+
+}
+#endif
@@ -0,0 +1,24 @@
+#ifndef __RDB_DUMP_H__
+#define __RDB_DUMP_H__
+
+#include <stdint.h>
+#include <string>
+#include "slice.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+// Build the serialized value DUMP returns and RESTORE accepts: the value
+// type byte, the encoded value, the rdb version as two little endian bytes
+// and a little endian crc64 over all of the preceding bytes.
+void CreateDumpPayload(uint8_t rdb_type, const Slice &raw_value,
+    int rdb_version, std::string *payload);
+
+// Same as above for a record parsed with ParseOptions::capture_raw set.
+inline void CreateDumpPayload(const ParsedResult &result, int rdb_version,
+    std::string *payload) {
+  CreateDumpPayload(result.rdb_type, result.raw_value, rdb_version, payload);
+}
+
+}
+#endif
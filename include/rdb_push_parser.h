@@ -0,0 +1,57 @@
+#ifndef __RDB_PUSH_PARSER_H__
+#define __RDB_PUSH_PARSER_H__
+
+#include <stdint.h>
+#include <vector>
+#include "status.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+class RdbParseImpl;
+class BufferSequentialFile;
+
+// Parses an rdb stream handed over in chunks of any size, for callers
+// driven by an event loop. Only the bytes of the record being parsed are
+// buffered; a record cut by a chunk boundary is parsed again once the bytes
+// its failed read asked for arrived, never blocking for more. A list, set,
+// hash or zset goes on from the element that was cut, keeping the ones
+// already decoded; other values start again from their key.
+class RdbPushParser {
+  public:
+    explicit RdbPushParser(const ParseOptions &options = ParseOptions());
+    ~RdbPushParser();
+
+    // Consume |n| bytes and append every record they complete to |records|.
+    // Once the EOF opcode was parsed further bytes are ignored. Callbacks of
+    // ParseOptions run during the call, so parts of a chunked value may reach
+    // value_chunk before the records of earlier keys are returned here.
+    Status Feed(const char *data, size_t n, std::vector<ParsedResult> *records);
+    // End of input: parse what is still buffered, returns Incomplete when
+    // the stream stopped before the EOF opcode.
+    Status Finish(std::vector<ParsedResult> *records);
+
+    // EOF opcode reached
+    bool Done() const { return done_; }
+    // 0 until the header was parsed
+    int Version() const;
+    const std::vector<AuxKV> &AuxFields();
+    const ParseStats *Stats();
+    // bytes held for the record or element in progress
+    uint64_t buffered() const;
+
+    RdbPushParser(const RdbPushParser&) = delete;
+    RdbPushParser& operator=(const RdbPushParser&) = delete;
+  private:
+    Status Parse(bool force, std::vector<ParsedResult> *records);
+
+    BufferSequentialFile *buffer_;
+    RdbParseImpl *impl_;
+    bool header_done_;
+    bool done_;
+    // bytes past the buffer mark the failed read needed
+    uint64_t retry_at_;
+};
+
+}
+#endif
@@ -0,0 +1,87 @@
+#ifndef __RDB_REPLICATION_H__
+#define __RDB_REPLICATION_H__
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "status.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+class RdbPushParser;
+
+struct ReplicationOptions {
+  ReplicationOptions()
+    : psync(true), listening_port(0), timeout_ms(30000), ack_interval_ms(1000) {}
+  std::string password;
+  // ask for a full resync with PSYNC ? -1, falling back to SYNC when the
+  // endpoint refuses it; SYNC only when false
+  bool psync;
+  // announced with REPLCONF listening-port, 0 skips it
+  int listening_port;
+  // fail when the endpoint stays silent that long, the master sends PINGs
+  // and newlines to keep an idle link alive
+  int timeout_ms;
+  // REPLCONF ACK period while reading the command stream
+  int ack_interval_ms;
+  ParseOptions parse;
+};
+
+typedef std::function<Status(ParsedResult *)> RecordCallback;
+// One command of the replication stream; returning an error stops the read
+// and is passed back to the caller.
+typedef std::function<Status(const std::vector<std::string> &)> CommandCallback;
+
+// Parses the snapshot a Redis compatible master streams to a replica during
+// a full resync, without writing it to disk, then optionally follows the
+// commands the master propagates afterwards.
+// Both the `$<len>` bulk framing and the `$EOF:<mark>` framing of diskless
+// replication are handled.
+class ReplicationSource {
+  public:
+    static Status Open(const std::string &host, int port,
+        const ReplicationOptions &options, ReplicationSource **source);
+    ~ReplicationSource();
+
+    // Run the sync handshake and hand every record of the snapshot to |cb|,
+    // returns once the snapshot was parsed up to its EOF opcode.
+    Status ReadSnapshot(const RecordCallback &cb);
+    // Hand every command propagated after the snapshot to |cb| until it
+    // returns an error or the master closes the link. PINGs and
+    // REPLCONF GETACK are answered here and passed on too.
+    Status ReadCommands(const CommandCallback &cb);
+
+    // Set by +FULLRESYNC, empty after a plain SYNC.
+    const std::string &replid() const { return replid_; }
+    // Replication offset of the last command read, -1 after a plain SYNC.
+    int64_t offset() const { return offset_; }
+    int Version() const;
+    const std::vector<AuxKV> &AuxFields();
+    // snapshot bytes read so far
+    uint64_t snapshot_bytes() const { return snapshot_bytes_; }
+
+    ReplicationSource(const ReplicationSource&) = delete;
+    ReplicationSource& operator=(const ReplicationSource&) = delete;
+  private:
+    explicit ReplicationSource(const ReplicationOptions &options);
+    Status Handshake();
+    Status SendCommand(const std::vector<std::string> &argv);
+    Status ReadLine(std::string *line);
+    Status Fill(int wait_ms);
+    Status SendAck();
+
+    ReplicationOptions options_;
+    int fd_;
+    std::string rbuf_;
+    size_t rpos_;
+    RdbPushParser *parser_;
+    std::string replid_;
+    int64_t offset_;
+    uint64_t snapshot_bytes_;
+    bool snapshot_done_;
+};
+
+}
+#endif
@@ -0,0 +1,73 @@
+#ifndef __RDB_WRITER_H__
+#define __RDB_WRITER_H__
+
+#include <stdint.h>
+#include <string>
+#include "status.h"
+#include "slice.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+struct RdbWriterOptions {
+  RdbWriterOptions() : block_size(4 << 20) {}
+  // bytes buffered before each write(2)
+  size_t block_size;
+};
+
+// Writes a valid rdb file. Entries are written from their raw encoded value
+// as captured by the parser, so nothing is re-encoded.
+class RdbWriter {
+  public:
+    static Status Open(const std::string &path, const RdbWriterOptions &options,
+        RdbWriter **writer);
+    // Closes the file, a writer destroyed before Finish() leaves a
+    // truncated file behind.
+    ~RdbWriter();
+
+    Status WriteHeader(int version);
+    Status WriteAux(const Slice &key, const Slice &val);
+    Status WriteSelectDb(uint32_t db_num);
+    Status WriteResizeDb(uint64_t db_size, uint64_t expire_size);
+    // Write one key, |expire_ms| is an absolute unix time in milliseconds
+    // or -1 when the key has no TTL.
+    Status WriteRawEntry(uint8_t rdb_type, const Slice &key,
+        const Slice &raw_value, int64_t expire_ms = -1);
+    // Write a record parsed with ParseOptions::capture_raw set, switching
+    // the selected db first when it changed.
+    Status WriteEntry(const ParsedResult &result);
+    // Write the EOF opcode and the checksum, then flush and close the file.
+    Status Finish();
+
+    // Primitive encoders, for callers assembling values themselves.
+    Status WriteLength(uint64_t len);
+    Status WriteString(const Slice &str);
+    Status WriteRaw(const char *data, size_t len);
+
+    int version() const { return version_; }
+    uint64_t bytes_written() const { return offset_; }
+
+    RdbWriter(const RdbWriter&) = delete;
+    RdbWriter& operator=(const RdbWriter&) = delete;
+  private:
+    RdbWriter(const std::string &path, int fd, const RdbWriterOptions &options);
+    Status Flush();
+    Status WriteFd(const char *data, size_t len);
+    Status WriteByte(uint8_t b) {
+      char c = static_cast<char>(b);
+      return WriteRaw(&c, 1);
+    }
+
+    std::string path_;
+    int fd_;
+    char *buf_;
+    size_t buf_size_;
+    size_t buf_used_;
+    uint64_t offset_;
+    uint64_t check_sum_;
+    int version_;
+    int64_t db_num_;
+};
+
+}
+#endif
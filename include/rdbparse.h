@@ -5,8 +5,12 @@
 #include <map>
 #include <list>
 #include <set> 
+#include <vector>
 #include "status.h" 
 #include "slice.h"
+#include "parse_stats.h"
+#include "parse_progress.h"
+#include "parse_stream.h"
 
 namespace parser {
 
@@ -14,8 +18,17 @@ struct AuxKV {
   std::string aux_key;  
   std::string aux_val;
 };
+// Which part of a value a ParsedResult holds, see ParseOptions::chunk_bytes.
+enum ValueChunk {
+  kWholeValue = 0,
+  kFirstChunk,
+  kMiddleChunk,
+  kLastChunk
+};
+
 struct ParsedResult {
-  ParsedResult(): expire_time(-1) {}
+  ParsedResult(): db_num(0), idle(0), db_size(0), expire_size(0), freq(0),
+    expire_time(-1), rdb_type(0), chunk(kWholeValue) {}
   std::string type;
   uint32_t db_num;
   uint32_t idle;
@@ -23,7 +36,12 @@ struct ParsedResult {
   uint32_t expire_size;
   uint32_t freq;
   AuxKV aux_field;
-  int expire_time;
+  // unix time in milliseconds, -1 when the key does not expire
+  int64_t expire_time;
+  // value type byte as stored in the rdb file
+  uint8_t rdb_type;
+  // a ValueChunk
+  uint8_t chunk;
   void set_dbnum(uint32_t _db_num) {
     db_num = _db_num;
   } 
@@ -36,14 +54,14 @@ struct ParsedResult {
   void set_expiresize(uint32_t _exire_size) {
     expire_size = _exire_size;
   }
-  void set_expiretime(int _expire_time) {
+  void set_expiretime(int64_t _expire_time) {
     expire_time = _expire_time;
   }
   void set_freq(uint32_t _freq) {
     freq = _freq;
   }
   void set_auxkv(const std::string &key, const std::string val) {
-    aux_field.aux_val = key; 
+    aux_field.aux_key = key; 
     aux_field.aux_val = val;
   }
   std::string key;
@@ -52,15 +70,115 @@ struct ParsedResult {
   std::map<std::string, std::string> map_value;
   std::map<std::string, double> zset_value;
   std::list<std::string> list_value;
+  // members of an intset encoded set, ascending, instead of set_value when
+  // ParseOptions::intset_as_ints is set
+  std::vector<int64_t> intset_value;
+  // encoded value bytes exactly as read, see ParseOptions::capture_raw
+  std::string raw_value;
+  // groups and ids of a decoded stream, its entries go through
+  // ParseOptions::stream_entry
+  StreamInfo stream_value;
   void Debug();
 };
 
+// Gets every part of a chunked value but the last, see
+// ParseOptions::chunk_bytes. A status other than OK aborts the parse.
+typedef std::function<Status(const ParsedResult &part)> ValueChunkCallback;
+
+struct ParseOptions {
+  ParseOptions()
+    : capture_raw(false), decode_value(true), collect_stats(false),
+      stats_sample_period(64), progress_bytes(64 << 20),
+      progress_interval_ms(1000), follow(false), follow_timeout_ms(60000),
+      decompress_threads(0), checkpoint_interval_ms(10000),
+      chunk_bytes(0), decode_threads(1), parallel_decode_nodes(32),
+      intset_as_ints(false), expired_as_of_ms(0) {}
+  // Keep the encoded bytes of every value in ParsedResult::raw_value.
+  bool capture_raw;
+  // Build the decoded containers of every value. When false values are
+  // only skipped over (and captured if capture_raw is set).
+  bool decode_value;
+  // Fill the ParseStats returned by RdbParse::Stats(). Timers read the
+  // clock once every stats_sample_period calls, rounded to a power of 2.
+  bool collect_stats;
+  uint32_t stats_sample_period;
+  // Called every progress_bytes of file or progress_interval_ms, whichever
+  // comes first (0 disables either trigger), and once more at EOF. When
+  // progress_textfile is set the same report is written there for the
+  // Prometheus node exporter. Without both nothing is tracked.
+  ProgressCallback progress;
+  std::string progress_textfile;
+  uint64_t progress_bytes;
+  uint32_t progress_interval_ms;
+  // Parse a file that is still being written, like the temp file of a
+  // running BGSAVE: reads at its end wait for more bytes instead of failing
+  // with EndFile, and the trailing checksum is verified once the EOF opcode
+  // was read. Fails with Timeout when the file does not grow for
+  // follow_timeout_ms.
+  bool follow;
+  uint32_t follow_timeout_ms;
+  // gzip, zstd and lz4 files are told by their magic bytes and decompressed
+  // while parsing, given the library was built with ENABLE_ZLIB, ENABLE_ZSTD
+  // or ENABLE_LZ4. The frames of a multi-frame zstd file are decompressed on
+  // this many threads, 0 for one per core.
+  int decompress_threads;
+  // When set, a ParseCheckpoint is written there every
+  // checkpoint_interval_ms, at the start of the Next() call that follows:
+  // records returned before are taken as consumed. Callers that buffer
+  // records should write their own with GetCheckpoint() instead.
+  std::string checkpoint_path;
+  uint32_t checkpoint_interval_ms;
+  // Gets the entries of every stream, one at a time, while decode_value is
+  // set. Value() already holds the key.
+  StreamEntryCallback stream_entry;
+  // Split decoded values growing past chunk_bytes into parts of about that
+  // size, so no key needs more memory than that: strings are read and LZF
+  // decompressed in slices, collections cut between elements. Every part
+  // but the last goes to value_chunk as soon as it is full, the last one is
+  // returned by Next(), with ParsedResult::chunk telling them apart. Values
+  // stored as a single ziplist, listpack or intset, single elements and a
+  // captured raw_value are never cut. Needs value_chunk, 0 disables it.
+  uint64_t chunk_bytes;
+  ValueChunkCallback value_chunk;
+  // Quicklists of at least parallel_decode_nodes nodes have their nodes
+  // decompressed and decoded on this many threads, 0 for one per core,
+  // while the next nodes are read; 1 decodes everything on the caller's
+  // thread. Not used for chunked values. Sampled timers of ParseStats do
+  // not cover the parallel work.
+  int decode_threads;
+  uint32_t parallel_decode_nodes;
+  // Return intset encoded sets as integers in ParsedResult::intset_value,
+  // skipping a string and a tree node per member.
+  bool intset_as_ints;
+  // Drop the keys already expired at this unix time in milliseconds, as
+  // redis does when it loads a dump: their values are skipped, not decoded
+  // or captured, and Next() goes on with the next entry. Counted in
+  // ParseStats::expired_keys. 0 keeps every key.
+  int64_t expired_as_of_ms;
+};
+
+struct ParseCheckpoint;
+
 class RdbParse {
   public:
     static Status Open(const std::string &path, RdbParse **rdb);
+    static Status Open(const std::string &path, const ParseOptions &options,
+        RdbParse **rdb);
+    // Reopen |path| and go on where |resume_from| was taken, without
+    // parsing the bytes before it. Fails when the file is not the one the
+    // checkpoint was taken from, as far as its version and size tell.
+    static Status Open(const std::string &path, const ParseCheckpoint &resume_from,
+        const ParseOptions &options, RdbParse **rdb);
     virtual Status Next() = 0;
     virtual bool Valid() = 0; 
     virtual ParsedResult *Value() = 0; 
+    virtual int Version() = 0;
+    // aux fields seen so far, they all precede the first key
+    virtual const std::vector<AuxKV> &AuxFields() = 0;
+    // NULL unless ParseOptions::collect_stats is set
+    virtual const ParseStats *Stats() = 0;
+    // Parser state before the entry the next Next() call returns.
+    virtual Status GetCheckpoint(ParseCheckpoint *checkpoint) = 0;
     RdbParse() = default;
     virtual ~RdbParse();
     RdbParse(const RdbParse&) = delete; 
@@ -0,0 +1,102 @@
+#ifndef __RESP_EXPORTER_H__
+#define __RESP_EXPORTER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "status.h"
+#include "slice.h"
+#include "rdbparse.h"
+
+namespace parser {
+
+// Turns parsed records into RESP commands. Large collections are split into
+// several commands of at most batch_elements elements each.
+class RespEncoder {
+  public:
+    explicit RespEncoder(size_t batch_elements = 128)
+      : batch_elements_(batch_elements ? batch_elements : 1) {}
+
+    // Append the commands rebuilding |result| to |out|: SET, RPUSH, HSET,
+    // ZADD or SADD, an optional leading DEL and a trailing PEXPIREAT.
+    // Records of types that have no command form (modules, streams) are
+    // reported as NotSupported and nothing is appended. Parts of a chunked
+    // value are encoded to add to the earlier ones.
+    Status Encode(const ParsedResult &result, bool replace,
+        std::string *out, size_t *commands) const;
+    // Append a RESTORE of |result|, which must have been parsed with
+    // ParseOptions::capture_raw, carrying its TTL as an absolute ABSTTL.
+    Status EncodeRestore(const ParsedResult &result, int rdb_version,
+        bool replace, std::string *out, size_t *commands) const;
+
+    static void AppendCommand(const std::vector<Slice> &argv, std::string *out);
+    static void AppendArrayHeader(size_t n, std::string *out);
+    static void AppendBulk(const Slice &arg, std::string *out);
+  private:
+    size_t batch_elements_;
+};
+
+struct RespExporterOptions {
+  RespExporterOptions()
+    : connections(4), pipeline_window(1024), batch_elements(128),
+      replace(false), timeout_ms(30000) {}
+  // number of connections opened to the target; keys are routed to a
+  // connection by hash so commands of one key stay ordered
+  int connections;
+  // max commands in flight without a reply, per connection
+  int pipeline_window;
+  size_t batch_elements;
+  // DEL every key before rebuilding it
+  bool replace;
+  std::string password;
+  int timeout_ms;
+};
+
+class RespExporter {
+  public:
+    static Status Open(const std::string &host, int port,
+        const RespExporterOptions &options, RespExporter **exporter);
+    ~RespExporter();
+
+    // Queue the commands of one record, waiting for replies only when the
+    // record's connection has a full window.
+    Status Append(const ParsedResult &result);
+    // Queue one RESTORE carrying the record's raw value, see
+    // RespEncoder::EncodeRestore.
+    Status AppendRestore(const ParsedResult &result, int rdb_version);
+    // Queue a single raw command on the connection owning |key|.
+    Status AppendCommand(const std::vector<Slice> &argv, uint32_t db_num);
+    // Wait until every queued command has been acknowledged.
+    Status Flush();
+
+    uint64_t commands() const { return commands_; }
+    uint64_t replies() const { return replies_; }
+    uint64_t errors() const { return errors_; }
+    uint64_t skipped() const { return skipped_; }
+    const std::string &first_error() const { return first_error_; }
+
+    RespExporter(const RespExporter&) = delete;
+    RespExporter& operator=(const RespExporter&) = delete;
+  private:
+    struct Conn;
+    explicit RespExporter(const RespExporterOptions &options);
+    Conn *Route(const Slice &key);
+    Status QueueEncoded(const ParsedResult &result, const Status &encoded, size_t n);
+    Status Queue(Conn *conn, uint32_t db_num, const std::string &cmds, size_t n);
+    Status Pump(bool drain);
+    Status HandleWrite(Conn *conn);
+    Status HandleRead(Conn *conn);
+
+    RespExporterOptions options_;
+    RespEncoder encoder_;
+    std::vector<Conn *> conns_;
+    std::string scratch_;
+    uint64_t commands_;
+    uint64_t replies_;
+    uint64_t errors_;
+    uint64_t skipped_;
+    std::string first_error_;
+};
+
+}
+#endif
@@ -0,0 +1,70 @@
+#ifndef __SLOT_SPLITTER_H__
+#define __SLOT_SPLITTER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "status.h"
+#include "slice.h"
+#include "rdbparse.h"
+#include "rdb_writer.h"
+
+namespace parser {
+
+static const int kClusterSlots = 16384;
+
+// Redis Cluster hash slot of |key|: CRC16 of the key, or of the part
+// between its first '{' and the next '}' when that part is not empty.
+uint16_t KeyHashSlot(const Slice &key);
+
+struct SlotRange {
+  SlotRange(uint16_t f, uint16_t l) : first(f), last(l) {}
+  // inclusive
+  uint16_t first;
+  uint16_t last;
+};
+
+class SplitOutput;
+
+// Splits an rdb file by cluster hash slot in one pass. Every key is copied
+// from its raw encoded value, never decoded, to the output owning its slot;
+// keys of slots no output owns are dropped.
+class SlotSplitter {
+  public:
+    SlotSplitter();
+    ~SlotSplitter();
+
+    // A new rdb file holding the keys of |ranges|, with the aux fields of
+    // the input.
+    Status AddRdbOutput(const std::string &path, const std::vector<SlotRange> &ranges,
+        const RdbWriterOptions &options = RdbWriterOptions());
+    // A new file of RESTORE ... ABSTTL commands for the keys of |ranges|,
+    // ready for `redis-cli --pipe`. |block_size| bytes are buffered per
+    // write.
+    Status AddRespOutput(const std::string &path, const std::vector<SlotRange> &ranges,
+        bool replace = false, size_t block_size = 4 << 20);
+
+    // Parse |path| and route its keys, then finish every output. |options|
+    // is used with capture_raw set and decode_value cleared.
+    Status Split(const std::string &path, const ParseOptions &options = ParseOptions());
+
+    uint64_t keys() const { return keys_; }
+    uint64_t dropped() const { return dropped_; }
+    size_t outputs() const { return outputs_.size(); }
+    // keys routed to the output added |index|-th
+    uint64_t output_keys(size_t index) const;
+
+    SlotSplitter(const SlotSplitter&) = delete;
+    SlotSplitter& operator=(const SlotSplitter&) = delete;
+  private:
+    Status AddOutput(SplitOutput *output, const std::vector<SlotRange> &ranges);
+
+    std::vector<SplitOutput *> outputs_;
+    // output index per slot, -1 when the slot is dropped
+    std::vector<int32_t> slot_output_;
+    uint64_t keys_;
+    uint64_t dropped_;
+};
+
+}
+#endif
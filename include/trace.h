@@ -0,0 +1,26 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <string>
+#include "status.h"
+
+namespace parser {
+
+// Span tracing of the decode phases, compiled in with `make ENABLE_TRACE=1`.
+// Without it the spans compile to nothing, TraceEnabled() is false and
+// TraceExportChrome returns NotSupported.
+bool TraceEnabled();
+// Keys whose decode takes at least |micros| are logged to stderr with their
+// file offset and kept for the export, 0 turns this off. Defaults to 10ms.
+void TraceSetSlowKeyThreshold(uint64_t micros);
+// Write the events recorded so far by every thread as Chrome trace JSON,
+// viewable in chrome://tracing or Perfetto. It may run while threads are
+// still tracing: events they overwrite during the export are left out.
+Status TraceExportChrome(const std::string &path);
+// Drop the events recorded so far; events recorded while it runs may be
+// kept or dropped.
+void TraceClear();
+
+}
+#endif
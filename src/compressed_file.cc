@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <deque>
+
+#include "compressed_file.h"
+
+#ifdef __ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef __ENABLE_ZSTD
+#include <zstd.h>
+#include "thread_pool.h"
+#endif
+#ifdef __ENABLE_LZ4
+#include <lz4frame.h>
+#endif
+
+namespace parser {
+
+CompressionType DetectCompression(const char *magic, size_t n) {
+  const unsigned char *m = reinterpret_cast<const unsigned char *>(magic);
+  if (n >= 2 && m[0] == 0x1f && m[1] == 0x8b) {
+    return kGzipCompression;
+  }
+  if (n >= 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd) {
+    return kZstdCompression;
+  }
+  if (n >= 4 && m[0] == 0x04 && m[1] == 0x22 && m[2] == 0x4d && m[3] == 0x18) {
+    return kLz4Compression;
+  }
+  return kNoCompression;
+}
+
+const char *CompressionName(CompressionType type) {
+  switch (type) {
+    case kGzipCompression: return "gzip";
+    case kZstdCompression: return "zstd";
+    case kLz4Compression: return "lz4";
+    default: return "none";
+  }
+}
+
+DecompressSequentialFile::DecompressSequentialFile(const std::string& fname, FILE* f)
+  : filename_(fname), file_(f), input_eof_(false), pos_(0) {
+}
+
+DecompressSequentialFile::~DecompressSequentialFile() {
+  fclose(file_);
+}
+
+size_t DecompressSequentialFile::ReadInput(size_t n, std::string *buf) {
+  size_t offset = buf->size();
+  buf->resize(offset + n);
+  size_t r = fread_unlocked(&(*buf)[offset], 1, n, file_);
+  buf->resize(offset + r);
+  if (r < n) {
+    input_eof_ = true;
+  }
+  return r;
+}
+
+Status DecompressSequentialFile::Fill() {
+  chunk_.clear();
+  pos_ = 0;
+  Status s = NextChunk(&chunk_);
+  if (s.ok() && chunk_.empty()) {
+    if (ferror(file_)) {
+      return Status::IOError(filename_, strerror(errno));
+    }
+    return Status::EndFile(filename_, "end file");
+  }
+  return s;
+}
+
+Status DecompressSequentialFile::Read(size_t n, Slice* result, char* scratch) {
+  size_t done = 0;
+  Status s;
+  while (done < n) {
+    if (pos_ == chunk_.size()) {
+      s = Fill();
+      if (!s.ok()) {
+        break;
+      }
+    }
+    size_t len = std::min(n - done, chunk_.size() - pos_);
+    memcpy(scratch + done, chunk_.data() + pos_, len);
+    pos_ += len;
+    done += len;
+  }
+  if (result) {
+    *result = Slice(scratch, done);
+  }
+  return s;
+}
+
+Status DecompressSequentialFile::Skip(uint64_t n) {
+  while (n > 0) {
+    if (pos_ == chunk_.size()) {
+      Status s = Fill();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    size_t len = std::min<uint64_t>(n, chunk_.size() - pos_);
+    pos_ += len;
+    n -= len;
+  }
+  return Status::OK();
+}
+
+#ifdef __ENABLE_ZLIB
+// gzip or zlib, concatenated gzip members (pigz, appended logs) included.
+class GzipSequentialFile : public DecompressSequentialFile {
+  public:
+    GzipSequentialFile(const std::string& fname, FILE* f)
+      : DecompressSequentialFile(fname, f), in_pos_(0), stream_end_(false) {
+      memset(&zs_, 0, sizeof(zs_));
+      ok_ = inflateInit2(&zs_, 15 + 32) == Z_OK;
+    }
+    virtual ~GzipSequentialFile() {
+      inflateEnd(&zs_);
+    }
+  protected:
+    virtual Status NextChunk(std::string *out) {
+      if (!ok_) {
+        return Status::IOError(filename_, "inflateInit failed");
+      }
+      out->resize(kChunkSize);
+      zs_.next_out = reinterpret_cast<Bytef *>(&(*out)[0]);
+      zs_.avail_out = out->size();
+      while (zs_.avail_out > 0) {
+        if (in_pos_ == input_.size()) {
+          input_.clear();
+          in_pos_ = 0;
+          if (input_eof_ || ReadInput(kChunkSize, &input_) == 0) {
+            if (!stream_end_) {
+              return Status::Corruption(filename_, "truncated gzip stream");
+            }
+            break;
+          }
+        }
+        if (stream_end_) {
+          // another member follows
+          inflateReset(&zs_);
+          stream_end_ = false;
+        }
+        zs_.next_in = reinterpret_cast<Bytef *>(&input_[in_pos_]);
+        zs_.avail_in = input_.size() - in_pos_;
+        int r = inflate(&zs_, Z_NO_FLUSH);
+        in_pos_ = input_.size() - zs_.avail_in;
+        if (r == Z_STREAM_END) {
+          stream_end_ = true;
+        } else if (r != Z_OK && r != Z_BUF_ERROR) {
+          return Status::Corruption(filename_, zs_.msg ? zs_.msg : "bad gzip data");
+        }
+      }
+      out->resize(out->size() - zs_.avail_out);
+      return Status::OK();
+    }
+  private:
+    z_stream zs_;
+    bool ok_;
+    std::string input_;
+    size_t in_pos_;
+    bool stream_end_;
+};
+#endif
+
+#ifdef __ENABLE_ZSTD
+// Multi-frame files (zstd -T, pzstd, or any concatenation) have every frame
+// decompressed on the pool, a window of frames ahead of the reader. A frame
+// larger than kMaxParallelFrame, typically a whole file in a single frame,
+// is streamed on the calling thread instead.
+class ZstdSequentialFile : public DecompressSequentialFile {
+  public:
+    ZstdSequentialFile(const std::string& fname, FILE* f, int threads, ThreadPool *pool)
+      : DecompressSequentialFile(fname, f), own_pool_(pool ? NULL : new ThreadPool(threads)),
+        pool_(pool ? pool : own_pool_), dstream_(NULL), streaming_(false),
+        in_pos_(0), frame_left_(0) {
+      max_jobs_ = 2 * pool_->size();
+    }
+    virtual ~ZstdSequentialFile() {
+      for (Job *job : jobs_) {
+        job->done.wait();
+        delete job;
+      }
+      ZSTD_freeDStream(dstream_);
+      delete own_pool_;
+    }
+  protected:
+    virtual Status NextChunk(std::string *out) {
+      while (out->empty()) {
+        if (!streaming_) {
+          Schedule();
+        }
+        if (!jobs_.empty()) {
+          Job *job = jobs_.front();
+          jobs_.pop_front();
+          Status s = job->done.get();
+          out->swap(job->output);
+          delete job;
+          if (!s.ok()) {
+            return s;
+          }
+        } else if (streaming_) {
+          return Stream(out);
+        } else {
+          break;
+        }
+      }
+      return Status::OK();
+    }
+  private:
+    static const size_t kMaxParallelFrame = 32 << 20;
+
+    struct Job {
+      std::string input;
+      std::string output;
+      std::future<Status> done;
+    };
+
+    static Status DecompressFrame(const std::string &in, std::string *out) {
+      ZSTD_DCtx *dctx = ZSTD_createDCtx();
+      std::string buf(ZSTD_DStreamOutSize(), '\0');
+      ZSTD_inBuffer input = {in.data(), in.size(), 0};
+      Status s;
+      while (true) {
+        ZSTD_outBuffer output = {&buf[0], buf.size(), 0};
+        size_t r = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(r)) {
+          s = Status::Corruption("zstd", ZSTD_getErrorName(r));
+          break;
+        }
+        out->append(buf.data(), output.pos);
+        if (input.pos == input.size && output.pos < output.size) {
+          if (r != 0) {
+            s = Status::Corruption("zstd", "truncated frame");
+          }
+          break;
+        }
+      }
+      ZSTD_freeDCtx(dctx);
+      return s;
+    }
+
+    // Queue whole frames until the window is full. A frame that cannot be
+    // delimited in kMaxParallelFrame bytes switches to streaming, which
+    // also reports a truncated last frame.
+    void Schedule() {
+      while (static_cast<int>(jobs_.size()) < max_jobs_) {
+        size_t frame = 0;
+        while (true) {
+          if (!input_.empty()) {
+            frame = ZSTD_findFrameCompressedSize(input_.data(), input_.size());
+            if (!ZSTD_isError(frame)) {
+              break;
+            }
+          }
+          if (input_eof_ || input_.size() >= kMaxParallelFrame
+              || ReadInput(kChunkSize, &input_) == 0) {
+            if (!input_.empty()) {
+              streaming_ = true;
+            }
+            return;
+          }
+        }
+        Job *job = new Job;
+        job->input.assign(input_, 0, frame);
+        input_.erase(0, frame);
+        job->done = pool_->Submit([job]() { return DecompressFrame(job->input, &job->output); });
+        jobs_.push_back(job);
+      }
+    }
+
+    Status Stream(std::string *out) {
+      if (dstream_ == NULL) {
+        dstream_ = ZSTD_createDStream();
+        ZSTD_initDStream(dstream_);
+      }
+      out->resize(kChunkSize);
+      ZSTD_outBuffer output = {&(*out)[0], out->size(), 0};
+      while (output.pos < output.size) {
+        if (in_pos_ == input_.size()) {
+          input_.clear();
+          in_pos_ = 0;
+          if (input_eof_ || ReadInput(kChunkSize, &input_) == 0) {
+            if (frame_left_ != 0) {
+              return Status::Corruption(filename_, "truncated zstd stream");
+            }
+            break;
+          }
+        }
+        ZSTD_inBuffer input = {input_.data(), input_.size(), in_pos_};
+        size_t r = ZSTD_decompressStream(dstream_, &output, &input);
+        if (ZSTD_isError(r)) {
+          return Status::Corruption(filename_, ZSTD_getErrorName(r));
+        }
+        in_pos_ = input.pos;
+        frame_left_ = r;
+      }
+      out->resize(output.pos);
+      return Status::OK();
+    }
+
+    ThreadPool *own_pool_;
+    ThreadPool *pool_;
+    int max_jobs_;
+    std::deque<Job *> jobs_;
+    ZSTD_DStream *dstream_;
+    bool streaming_;
+    std::string input_;
+    size_t in_pos_;
+    // ZSTD_decompressStream hint, 0 once a frame is complete
+    size_t frame_left_;
+};
+#endif
+
+#ifdef __ENABLE_LZ4
+class Lz4SequentialFile : public DecompressSequentialFile {
+  public:
+    Lz4SequentialFile(const std::string& fname, FILE* f)
+      : DecompressSequentialFile(fname, f), dctx_(NULL), in_pos_(0), frame_left_(0) {
+      ok_ = !LZ4F_isError(LZ4F_createDecompressionContext(&dctx_, LZ4F_VERSION));
+    }
+    virtual ~Lz4SequentialFile() {
+      LZ4F_freeDecompressionContext(dctx_);
+    }
+  protected:
+    virtual Status NextChunk(std::string *out) {
+      if (!ok_) {
+        return Status::IOError(filename_, "LZ4F_createDecompressionContext failed");
+      }
+      out->resize(kChunkSize);
+      size_t produced = 0;
+      while (produced < out->size()) {
+        if (in_pos_ == input_.size()) {
+          input_.clear();
+          in_pos_ = 0;
+          if (input_eof_ || ReadInput(kChunkSize, &input_) == 0) {
+            if (frame_left_ != 0) {
+              return Status::Corruption(filename_, "truncated lz4 stream");
+            }
+            break;
+          }
+        }
+        size_t dst_size = out->size() - produced;
+        size_t src_size = input_.size() - in_pos_;
+        size_t r = LZ4F_decompress(dctx_, &(*out)[produced], &dst_size,
+            &input_[in_pos_], &src_size, NULL);
+        if (LZ4F_isError(r)) {
+          return Status::Corruption(filename_, LZ4F_getErrorName(r));
+        }
+        produced += dst_size;
+        in_pos_ += src_size;
+        frame_left_ = r;
+      }
+      out->resize(produced);
+      return Status::OK();
+    }
+  private:
+    LZ4F_dctx *dctx_;
+    bool ok_;
+    std::string input_;
+    size_t in_pos_;
+    // LZ4F_decompress hint, 0 once a frame is complete
+    size_t frame_left_;
+};
+#endif
+
+Status NewDetectedSequentialFile(const std::string& fname, int threads,
+    ThreadPool* pool, SequentialFile** result) {
+  *result = NULL;
+  FILE* f = fopen(fname.c_str(), "r");
+  if (f == NULL) {
+    return Status::IOError(fname, strerror(errno));
+  }
+  char magic[4];
+  size_t n = fread(magic, 1, sizeof(magic), f);
+  if (fseek(f, 0, SEEK_SET) != 0) {
+    Status s = Status::IOError(fname, strerror(errno));
+    fclose(f);
+    return s;
+  }
+  CompressionType type = DetectCompression(magic, n);
+  switch (type) {
+    case kNoCompression:
+      // pipes and the like are read through stdio
+      if (NewMmapSequentialFile(fname, f, result).ok()) {
+        fclose(f);
+      } else {
+        *result = new PosixSequentialFile(fname, f);
+      }
+      return Status::OK();
+#ifdef __ENABLE_ZLIB
+    case kGzipCompression:
+      *result = new GzipSequentialFile(fname, f);
+      return Status::OK();
+#endif
+#ifdef __ENABLE_ZSTD
+    case kZstdCompression:
+      *result = new ZstdSequentialFile(fname, f, threads, pool);
+      return Status::OK();
+#endif
+#ifdef __ENABLE_LZ4
+    case kLz4Compression:
+      *result = new Lz4SequentialFile(fname, f);
+      return Status::OK();
+#endif
+    default:
+      fclose(f);
+      return Status::NotSupported(std::string(CompressionName(type))
+          + " input needs a library built with",
+          type == kGzipCompression ? "ENABLE_ZLIB=1"
+          : type == kZstdCompression ? "ENABLE_ZSTD=1" : "ENABLE_LZ4=1");
+  }
+}
+
+}
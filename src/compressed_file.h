@@ -0,0 +1,59 @@
+#ifndef __COMPRESSED_FILE_H__
+#define __COMPRESSED_FILE_H__
+
+#include <stdio.h>
+#include <string>
+#include "util.h"
+
+namespace parser {
+
+class ThreadPool;
+
+enum CompressionType {
+  kNoCompression,
+  kGzipCompression,
+  kZstdCompression,
+  kLz4Compression,
+};
+
+// Tell the format of a file from its first bytes.
+CompressionType DetectCompression(const char *magic, size_t n);
+const char *CompressionName(CompressionType type);
+
+// A compressed file decompressed on the fly, in chunks handed out by
+// NextChunk, so the rdb never lands on disk uncompressed.
+class DecompressSequentialFile : public SequentialFile {
+  public:
+    virtual ~DecompressSequentialFile();
+    virtual Status Read(size_t n, Slice* result, char* scratch);
+    virtual Status Skip(uint64_t n);
+    virtual Slice Peek() { return Slice(chunk_.data() + pos_, chunk_.size() - pos_); }
+    virtual void Advance(size_t n) { pos_ += n; }
+  protected:
+    static const size_t kChunkSize = 1 << 20;
+
+    DecompressSequentialFile(const std::string& fname, FILE* f);
+    // Replace |out| with the next decompressed bytes, left empty at the end
+    // of the file.
+    virtual Status NextChunk(std::string *out) = 0;
+    // Append up to |n| compressed bytes to |buf|, returns how many.
+    size_t ReadInput(size_t n, std::string *buf);
+
+    std::string filename_;
+    FILE *file_;
+    bool input_eof_;
+  private:
+    Status Fill();
+
+    std::string chunk_;
+    size_t pos_;
+};
+
+// Open |fname| plain or, told by its magic bytes, through the matching
+// decompressor. zstd frames are decompressed on |threads| workers, or on
+// |pool| when it is not NULL; it must outlive the file.
+Status NewDetectedSequentialFile(const std::string& fname, int threads,
+    ThreadPool* pool, SequentialFile** result);
+
+}
+#endif
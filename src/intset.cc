@@ -1,4 +1,7 @@
 #include <stdio.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 #include "intset.h"
 #include "util.h"
 
@@ -27,6 +30,67 @@ Status Intset::Get(size_t pos, int64_t *v) {
   return Status::OK();
 }
 
+bool Intset::Valid(const char *buf, size_t len) {
+  if (len < sizeof(Intset)) {
+    return false;
+  }
+  uint32_t enc, n;
+  memcpy(&enc, buf, sizeof(enc));
+  memcpy(&n, buf + sizeof(enc), sizeof(n));
+  return (enc == sizeof(int16_t) || enc == sizeof(int32_t) || enc == sizeof(int64_t))
+    && static_cast<uint64_t>(n) * enc <= len - sizeof(Intset);
+}
+
+void Intset::GetAll(int64_t *out) const {
+  const char *p = reinterpret_cast<const char *>(content);
+  size_t i = 0;
+  if (encoding == sizeof(int16_t)) {
+#if defined(__AVX2__)
+    for (; i + 8 <= length; i += 8) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 2));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtepi16_epi64(v));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 4),
+          _mm256_cvtepi16_epi64(_mm_srli_si128(v, 8)));
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 8 <= length; i += 8) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 2));
+      __m128i *o = reinterpret_cast<__m128i *>(out + i);
+      _mm_storeu_si128(o, _mm_cvtepi16_epi64(v));
+      _mm_storeu_si128(o + 1, _mm_cvtepi16_epi64(_mm_srli_si128(v, 4)));
+      _mm_storeu_si128(o + 2, _mm_cvtepi16_epi64(_mm_srli_si128(v, 8)));
+      _mm_storeu_si128(o + 3, _mm_cvtepi16_epi64(_mm_srli_si128(v, 12)));
+    }
+#endif
+    for (; i < length; i++) {
+      int16_t v16;
+      memcpy(&v16, p + i * 2, sizeof(v16));
+      out[i] = v16;
+    }
+  } else if (encoding == sizeof(int32_t)) {
+#if defined(__AVX2__)
+    for (; i + 4 <= length; i += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 4));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtepi32_epi64(v));
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 4 <= length; i += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 4));
+      __m128i *o = reinterpret_cast<__m128i *>(out + i);
+      _mm_storeu_si128(o, _mm_cvtepi32_epi64(v));
+      _mm_storeu_si128(o + 1, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+    }
+#endif
+    for (; i < length; i++) {
+      int32_t v32;
+      memcpy(&v32, p + i * 4, sizeof(v32));
+      out[i] = v32;
+    }
+  } else {
+    memcpy(out, p, static_cast<size_t>(length) * sizeof(int64_t));
+  }
+}
+
 Status Intset::Dump() {
   printf("encoding: %d\n", encoding);
   printf("length: %d\n", length);
@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "listpack.h"
+#include "numeric.h"
+#include "util.h"
+
+namespace parser {
+
+static const size_t kListpackHeaderSize = 6;
+
+// Bytes taken by the backlen of an entry of |len| bytes, see lpEncodeBacklen.
+static inline size_t BacklenSize(uint64_t len) {
+  return len <= 127 ? 1 : len < 16383 ? 2 : len < 2097151 ? 3
+    : len < 268435455 ? 4 : 5;
+}
+
+static inline int64_t LoadLittleEndian(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++) {
+    v |= static_cast<uint64_t>(p[i]) << (8 * i);
+  }
+  // sign extend from the top bit of the last byte
+  int shift = 64 - 8 * bytes;
+  return static_cast<int64_t>(v << shift) >> shift;
+}
+
+ListpackParser::ListpackParser(const char *buf, size_t len)
+  : buf_(buf), len_(len), offset_(kListpackHeaderSize), end_(false),
+    corrupt_(false) {
+  uint32_t total = 0;
+  if (len >= kListpackHeaderSize) {
+    total = static_cast<uint32_t>(LoadLittleEndian(
+          reinterpret_cast<const uint8_t *>(buf), 4));
+  }
+  if (total < kListpackHeaderSize + 1 || total > len) {
+    corrupt_ = true;
+  } else {
+    len_ = total;
+  }
+}
+
+uint16_t ListpackParser::Count() const {
+  return len_ >= kListpackHeaderSize ? static_cast<uint16_t>(LoadLittleEndian(
+        reinterpret_cast<const uint8_t *>(buf_) + 4, 2)) : 0;
+}
+
+Status ListpackParser::status() const {
+  return corrupt_ ? Status::Corruption("parse listpack error") : Status::OK();
+}
+
+bool ListpackParser::Next(Slice *str, int64_t *v, bool *is_int) {
+  if (end_ || corrupt_) {
+    return false;
+  }
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(buf_) + offset_;
+  size_t avail = len_ - offset_;
+  uint8_t enc = p[0];
+  size_t header = 1;
+  uint64_t data = 0;
+  *is_int = true;
+  if (enc == kLpEnd) {
+    end_ = true;
+    return false;
+  } else if ((enc & 0x80) == kLpEnc7BitUint) {
+    *v = enc & 0x7f;
+  } else if ((enc & 0xc0) == kLpEnc6BitStr) {
+    *is_int = false;
+    data = enc & 0x3f;
+  } else if ((enc & 0xe0) == kLpEnc13BitInt) {
+    header = 2;
+    if (avail < 2) {
+      corrupt_ = true;
+      return false;
+    }
+    uint64_t uv = (static_cast<uint64_t>(enc & 0x1f) << 8) | p[1];
+    *v = uv >= (1 << 12) ? static_cast<int64_t>(uv) - (1 << 13) : static_cast<int64_t>(uv);
+  } else if ((enc & 0xf0) == kLpEnc12BitStr) {
+    header = 2;
+    if (avail < 2) {
+      corrupt_ = true;
+      return false;
+    }
+    *is_int = false;
+    data = (static_cast<uint64_t>(enc & 0x0f) << 8) | p[1];
+  } else if (enc == kLpEnc32BitStr) {
+    header = 5;
+    if (avail < 5) {
+      corrupt_ = true;
+      return false;
+    }
+    *is_int = false;
+    data = static_cast<uint32_t>(LoadLittleEndian(p + 1, 4));
+  } else if (enc >= kLpEncInt16 && enc <= kLpEncInt64) {
+    static const int kBytes[] = {2, 3, 4, 8};
+    data = kBytes[enc - kLpEncInt16];
+    if (avail < 1 + data) {
+      corrupt_ = true;
+      return false;
+    }
+    *v = LoadLittleEndian(p + 1, static_cast<int>(data));
+  } else {
+    corrupt_ = true;
+    return false;
+  }
+  uint64_t entry = header + data;
+  uint64_t size = entry + BacklenSize(entry);
+  // the terminator must still follow
+  if (size >= avail) {
+    corrupt_ = true;
+    return false;
+  }
+  if (!*is_int) {
+    *str = Slice(reinterpret_cast<const char *>(p) + header, data);
+  }
+  offset_ += size;
+  return true;
+}
+
+bool ListpackParser::Next(std::string *result) {
+  Slice str;
+  int64_t v;
+  bool is_int;
+  if (!Next(&str, &v, &is_int)) {
+    return false;
+  }
+  if (is_int) {
+    char buf[24];
+    result->assign(buf, FormatInt64(v, buf));
+  } else {
+    result->assign(str.data(), str.size());
+  }
+  return true;
+}
+
+bool ListpackParser::Next(Slice *str, char *int_buf) {
+  int64_t v;
+  bool is_int;
+  if (!Next(str, &v, &is_int)) {
+    return false;
+  }
+  if (is_int) {
+    *str = Slice(int_buf, FormatInt64(v, int_buf));
+  }
+  return true;
+}
+
+bool ListpackParser::NextInt(int64_t *v) {
+  Slice str;
+  bool is_int;
+  if (!Next(&str, v, &is_int)) {
+    return false;
+  }
+  long long ll;
+  if (!is_int) {
+    if (!string2ll(str.data(), str.size(), &ll)) {
+      corrupt_ = true;
+      return false;
+    }
+    *v = ll;
+  }
+  return true;
+}
+
+Status ListpackParser::GetList(std::list<std::string> *result) {
+  std::string value;
+  while (Next(&value)) {
+    result->push_back(value);
+  }
+  return status();
+}
+
+Status ListpackParser::GetSet(std::set<std::string> *result) {
+  std::string value;
+  while (Next(&value)) {
+    result->insert(value);
+  }
+  return status();
+}
+
+Status ListpackParser::GetZsetOrHash(std::map<std::string, std::string> *result) {
+  std::string key, value;
+  while (Next(&key)) {
+    if (!Next(&value)) {
+      corrupt_ = true;
+      break;
+    }
+    result->insert({key, value});
+  }
+  return status();
+}
+
+}
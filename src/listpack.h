@@ -0,0 +1,66 @@
+#ifndef __LISTPACK_H__
+#define __LISTPACK_H__
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include "include/slice.h"
+#include "include/status.h"
+
+namespace parser {
+
+enum ListpackEncType {
+  kLpEnc7BitUint = 0x00,       // 0xxxxxxx
+  kLpEnc6BitStr = 0x80,        // 10xxxxxx
+  kLpEnc13BitInt = 0xc0,       // 110xxxxx
+  kLpEnc12BitStr = 0xe0,       // 1110xxxx
+  kLpEnc32BitStr = 0xf0,
+  kLpEncInt16 = 0xf1,
+  kLpEncInt24 = 0xf2,
+  kLpEncInt32 = 0xf3,
+  kLpEncInt64 = 0xf4,
+  kLpEnd = 0xff
+};
+
+// Decodes the listpacks of Redis 7+ in place: a 4 byte total size, a 2
+// byte element count, the entries and a 0xff terminator. Every entry is
+// an encoding byte, its data and a backlen only needed to walk backwards;
+// its size follows from the entry length, so iterating forwards never
+// reads it.
+class ListpackParser {
+  public:
+    ListpackParser(const char *buf, size_t len);
+
+    // Next element, a string pointing into the buffer or an integer when
+    // *is_int. False at the terminator or on a malformed entry, tell them
+    // apart with status().
+    bool Next(Slice *str, int64_t *v, bool *is_int);
+    // Next element as a string, integers printed in decimal.
+    bool Next(std::string *result);
+    // Next element as a slice, integers printed into |int_buf|, which
+    // must hold kMaxIntChars.
+    bool Next(Slice *str, char *int_buf);
+    static const size_t kMaxIntChars = 21;
+    // Next element, which must be an integer.
+    bool NextInt(int64_t *v);
+    Status status() const;
+    bool end() const { return end_; }
+    // element count of the header, 65535 when it did not fit
+    uint16_t Count() const;
+
+    Status GetList(std::list<std::string> *result);
+    Status GetSet(std::set<std::string> *result);
+    // field/value or member/score pairs
+    Status GetZsetOrHash(std::map<std::string, std::string> *result);
+  private:
+    const char *buf_;
+    size_t len_;
+    size_t offset_;
+    bool end_;
+    bool corrupt_;
+};
+
+}
+#endif
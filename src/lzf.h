@@ -66,5 +66,14 @@
 unsigned int DecompressLzf(const void *const in_data,  unsigned int in_len,
                 void *out_data, unsigned int out_len);
 
+/*
+ * Compress in_len bytes stored at in_data into out_data, writing at most
+ * out_len bytes. Returns the compressed size, or 0 when the output does
+ * not fit (as with redis, pass out_len < in_len to only keep results that
+ * actually save space).
+ */
+unsigned int CompressLzf(const void *const in_data, unsigned int in_len,
+                void *out_data, unsigned int out_len);
+
 #endif
 
@@ -0,0 +1,79 @@
+#include <stdint.h>
+#include <string.h>
+#include "lzf.h"
+
+// A greedy single-probe compressor producing the lzf format read by
+// DecompressLzf: literal runs of up to 32 bytes (ctrl 000LLLLL) and back
+// references of 3 to 264 bytes within the previous 8192 bytes.
+static const int kHashLog = 14;
+static const unsigned int kMaxLiteral = 1 << 5;
+static const unsigned int kMaxOffset = 1 << 13;
+static const unsigned int kMaxRef = (1 << 8) + (1 << 3);
+
+static inline bool EmitLiterals(const uint8_t *lit, const uint8_t *end,
+    uint8_t **op, uint8_t *out_end) {
+  while (lit < end) {
+    unsigned int n = end - lit < kMaxLiteral ? end - lit : kMaxLiteral;
+    if (*op + 1 + n > out_end) {
+      return false;
+    }
+    *(*op)++ = static_cast<uint8_t>(n - 1);
+    memcpy(*op, lit, n);
+    *op += n;
+    lit += n;
+  }
+  return true;
+}
+
+unsigned int CompressLzf(const void *const in_data, unsigned int in_len,
+                void *out_data, unsigned int out_len) {
+  const uint8_t *in = static_cast<const uint8_t *>(in_data);
+  const uint8_t *ip = in, *lit = in;
+  const uint8_t *in_end = in + in_len;
+  uint8_t *op = static_cast<uint8_t *>(out_data);
+  uint8_t *out_end = op + out_len;
+  uint32_t htab[1 << kHashLog];
+  memset(htab, 0, sizeof(htab));
+
+  if (in_len == 0) {
+    return 0;
+  }
+  while (ip + 2 < in_end) {
+    uint32_t v = (ip[0] << 16) | (ip[1] << 8) | ip[2];
+    uint32_t h = (v * 2654435761u) >> (32 - kHashLog);
+    uint32_t pos = htab[h];
+    htab[h] = static_cast<uint32_t>(ip - in) + 1;
+    const uint8_t *ref = in + pos - 1;
+    if (pos == 0 || static_cast<unsigned int>(ip - ref) > kMaxOffset
+        || ref[0] != ip[0] || ref[1] != ip[1] || ref[2] != ip[2]) {
+      ip++;
+      continue;
+    }
+    unsigned int max_len = in_end - ip < kMaxRef ? in_end - ip : kMaxRef;
+    unsigned int len = 3;
+    while (len < max_len && ref[len] == ip[len]) {
+      len++;
+    }
+    if (!EmitLiterals(lit, ip, &op, out_end)) {
+      return 0;
+    }
+    unsigned int off = ip - ref - 1;
+    unsigned int l = len - 2;
+    if (op + (l < 7 ? 2 : 3) > out_end) {
+      return 0;
+    }
+    if (l < 7) {
+      *op++ = static_cast<uint8_t>((l << 5) | (off >> 8));
+    } else {
+      *op++ = static_cast<uint8_t>((7 << 5) | (off >> 8));
+      *op++ = static_cast<uint8_t>(l - 7);
+    }
+    *op++ = static_cast<uint8_t>(off & 0xff);
+    ip += len;
+    lit = ip;
+  }
+  if (!EmitLiterals(lit, in_end, &op, out_end)) {
+    return 0;
+  }
+  return op - static_cast<uint8_t *>(out_data);
+}
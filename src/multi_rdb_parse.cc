@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "include/multi_rdb_parse.h"
+#include "rdbparse_impl.h"
+#include "thread_pool.h"
+
+namespace parser {
+
+// Rough heap footprint of a decoded record, for the shared buffer limit.
+static uint64_t RecordBytes(const ParsedResult &r) {
+  static const uint64_t kNodeOverhead = 32;
+  uint64_t n = sizeof(ParsedResult) + r.key.size() + r.kv_value.size() + r.raw_value.size();
+  n += r.intset_value.size() * sizeof(int64_t);
+  for (const std::string &v : r.list_value) {
+    n += v.size() + kNodeOverhead;
+  }
+  for (const std::string &v : r.set_value) {
+    n += v.size() + kNodeOverhead;
+  }
+  for (const auto &kv : r.map_value) {
+    n += kv.first.size() + kv.second.size() + kNodeOverhead;
+  }
+  for (const auto &kv : r.zset_value) {
+    n += kv.first.size() + sizeof(double) + kNodeOverhead;
+  }
+  return n;
+}
+
+class MultiRdbParseImpl : public MultiRdbParse {
+  public:
+    MultiRdbParseImpl(const std::vector<std::string> &paths,
+        const MultiParseOptions &options)
+      : paths_(paths), options_(options), files_(paths.size()), done_files_(0),
+        buffered_bytes_(0), current_file_(0), next_file_(0), source_(0),
+        valid_(true), stop_(false), pool_(NULL), work_pool_(NULL) {}
+
+    virtual ~MultiRdbParseImpl() {
+      {
+        std::lock_guard<std::mutex> l(mu_);
+        stop_ = true;
+      }
+      space_cv_.notify_all();
+      // the pool joins its workers, files not started yet return at once
+      delete pool_;
+      delete work_pool_;
+    }
+
+    void Start() {
+      // every file decodes and decompresses on the same workers, so the
+      // thread counts of options_.parse hold for all of them together
+      int cores = std::thread::hardware_concurrency();
+      int threads = 0;
+      if (options_.parse.decode_threads != 1) {
+        threads = options_.parse.decode_threads > 0 ? options_.parse.decode_threads : cores;
+      }
+#ifdef __ENABLE_ZSTD
+      // only zstd decompresses on a pool
+      int decompress = options_.parse.decompress_threads;
+      threads = std::max(threads, decompress > 0 ? decompress : cores);
+#endif
+      if (threads > 0) {
+        work_pool_ = new ThreadPool(threads);
+      }
+      pool_ = new ThreadPool(std::min<int>(
+            options_.threads > 0 ? options_.threads : std::thread::hardware_concurrency(),
+            std::max<size_t>(paths_.size(), 1)));
+      for (size_t i = 0; i < paths_.size(); i++) {
+        pool_->Submit([this, i]() { ParseFile(i); });
+      }
+    }
+
+    virtual Status Next();
+    virtual bool Valid() { return valid_; }
+    virtual ParsedResult *Value() { return &current_; }
+    virtual size_t SourceIndex() { return source_; }
+    virtual const std::string &SourcePath() { return paths_[source_]; }
+
+  private:
+    struct FileQueue {
+      FileQueue() : done(false), reported(false) {}
+      std::deque<std::pair<ParsedResult, uint64_t>> records;
+      bool done;
+      Status status;
+      bool reported;
+      // nothing more will come out of this file
+      bool drained() const {
+        return done && records.empty() && (status.ok() || reported);
+      }
+      bool ready() const {
+        return !records.empty() || (done && !status.ok() && !reported);
+      }
+    };
+
+    void ParseFile(size_t index);
+    bool HasRoom(size_t index, uint64_t bytes) const {
+      return stop_ || buffered_bytes_ == 0
+        || buffered_bytes_ + bytes <= options_.max_buffered_bytes
+        || (options_.file_order && index == current_file_);
+    }
+
+    std::vector<std::string> paths_;
+    MultiParseOptions options_;
+    std::mutex mu_;
+    // records were queued or a file finished
+    std::condition_variable data_cv_;
+    // records were taken or the file being returned changed
+    std::condition_variable space_cv_;
+    std::vector<FileQueue> files_;
+    size_t done_files_;
+    uint64_t buffered_bytes_;
+    // the file returned in file_order mode
+    size_t current_file_;
+    // where the round robin over the files resumes otherwise
+    size_t next_file_;
+    size_t source_;
+    ParsedResult current_;
+    bool valid_;
+    bool stop_;
+    ThreadPool *pool_;
+    ThreadPool *work_pool_;
+};
+
+void MultiRdbParseImpl::ParseFile(size_t index) {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    if (stop_) {
+      return;
+    }
+  }
+  RdbParseImpl *parse = new RdbParseImpl(paths_[index], options_.parse, work_pool_);
+  Status s = parse->Init();
+  while (s.ok() && parse->Valid()) {
+    s = parse->Next();
+    if (!s.ok() || !parse->Valid()) {
+      break;
+    }
+    ParsedResult *r = parse->Value();
+    if (r->key.empty()) {
+      continue;
+    }
+    uint64_t bytes = RecordBytes(*r);
+    std::unique_lock<std::mutex> l(mu_);
+    space_cv_.wait(l, [&]() { return HasRoom(index, bytes); });
+    if (stop_) {
+      break;
+    }
+    files_[index].records.emplace_back(std::move(*r), bytes);
+    buffered_bytes_ += bytes;
+    l.unlock();
+    data_cv_.notify_one();
+  }
+  delete parse;
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    files_[index].done = true;
+    files_[index].status = s;
+    done_files_++;
+  }
+  data_cv_.notify_all();
+}
+
+Status MultiRdbParseImpl::Next() {
+  std::unique_lock<std::mutex> l(mu_);
+  size_t n = files_.size();
+  while (true) {
+    size_t index = n;
+    if (options_.file_order) {
+      while (current_file_ < n && files_[current_file_].drained()) {
+        current_file_++;
+        space_cv_.notify_all();
+      }
+      if (current_file_ < n && files_[current_file_].ready()) {
+        index = current_file_;
+      }
+    } else {
+      for (size_t i = 0; i < n && index == n; i++) {
+        size_t j = (next_file_ + i) % n;
+        if (files_[j].ready()) {
+          index = j;
+          next_file_ = j + 1;
+        }
+      }
+    }
+
+    if (index < n) {
+      FileQueue &f = files_[index];
+      source_ = index;
+      if (f.records.empty()) {
+        f.reported = true;
+        current_ = ParsedResult();
+        return f.status;
+      }
+      current_ = std::move(f.records.front().first);
+      buffered_bytes_ -= f.records.front().second;
+      f.records.pop_front();
+      l.unlock();
+      space_cv_.notify_all();
+      return Status::OK();
+    }
+    bool finished = options_.file_order ? current_file_ == n : done_files_ == n;
+    if (finished) {
+      valid_ = false;
+      current_ = ParsedResult();
+      return Status::OK();
+    }
+    data_cv_.wait(l);
+  }
+}
+
+Status MultiRdbParse::Open(const std::vector<std::string> &paths,
+    const MultiParseOptions &options, MultiRdbParse **rdb) {
+  *rdb = nullptr;
+  if (paths.empty()) {
+    return Status::InvalidArgument("no rdb file given");
+  }
+  if (!options.parse.checkpoint_path.empty()) {
+    // records wait in the shared buffer before the caller takes them
+    return Status::InvalidArgument("checkpoint_path is per file, not supported here");
+  }
+  MultiRdbParseImpl *impl = new MultiRdbParseImpl(paths, options);
+  impl->Start();
+  *rdb = impl;
+  return Status::OK();
+}
+
+MultiRdbParse::~MultiRdbParse() {
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef __NUMERIC_H__
+#define __NUMERIC_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace parser {
+
+// "00" "01" ... "99"
+extern const char kDigitPairs[201];
+
+// Decimal digits of |v|, two at a time, |buf| needs 20 bytes.
+static inline size_t FormatUint64(uint64_t v, char *buf) {
+  char tmp[20];
+  char *p = tmp + sizeof(tmp);
+  while (v >= 100) {
+    p -= 2;
+    memcpy(p, kDigitPairs + (v % 100) * 2, 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    p -= 2;
+    memcpy(p, kDigitPairs + v * 2, 2);
+  } else {
+    *--p = static_cast<char>('0' + v);
+  }
+  size_t n = tmp + sizeof(tmp) - p;
+  memcpy(buf, p, n);
+  return n;
+}
+
+static inline size_t FormatInt64(int64_t v, char *buf) {
+  if (v >= 0) {
+    return FormatUint64(static_cast<uint64_t>(v), buf);
+  }
+  buf[0] = '-';
+  return 1 + FormatUint64(0 - static_cast<uint64_t>(v), buf + 1);
+}
+
+// Convert a string into a long long. Returns 1 if the string could be
+// parsed into a (non-overflowing) long long, 0 otherwise. Leading zeros and
+// a '-' are accepted, nothing else. Eight digits are converted at a time.
+int string2ll(const char *s, size_t slen, long long *value);
+int string2l(const char *s, size_t slen, long *lval);
+// Same result as strtod consuming all |slen| bytes; |s| must be NUL
+// terminated. Plain decimals of up to 19 significant digits are converted
+// without strtod, exactly, by the Eisel-Lemire algorithm.
+int string2d(const char *s, size_t slen, double *dval);
+
+}
+#endif
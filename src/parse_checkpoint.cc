@@ -0,0 +1,112 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/parse_checkpoint.h"
+
+namespace parser {
+
+static const char kCheckpointMagic[] = "rdbparse_checkpoint 1";
+
+// aux values may hold any byte, they are stored in hex
+static std::string ToHex(const std::string &s) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (unsigned char c : s) {
+    hex.push_back(kDigits[c >> 4]);
+    hex.push_back(kDigits[c & 15]);
+  }
+  return hex.empty() ? "-" : hex;
+}
+
+static bool FromHex(const char *hex, std::string *s) {
+  s->clear();
+  if (strcmp(hex, "-") == 0) {
+    return true;
+  }
+  size_t n = strlen(hex);
+  if (n % 2) {
+    return false;
+  }
+  for (size_t i = 0; i < n; i += 2) {
+    unsigned int c;
+    if (sscanf(hex + i, "%2x", &c) != 1) {
+      return false;
+    }
+    s->push_back(static_cast<char>(c));
+  }
+  return true;
+}
+
+Status WriteCheckpoint(const std::string &path, const ParseCheckpoint &cp) {
+  std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (f == NULL) {
+    return Status::IOError(tmp, strerror(errno));
+  }
+  fprintf(f, "%s\nversion %d\noffset %lu\nfile_size %lu\ndb_num %u\ndb_size %u\n"
+      "expire_size %u\ncheck_sum %lu\ncheck_sum_partial %d\nkeys %lu\n",
+      kCheckpointMagic, cp.version, cp.offset, cp.file_size, cp.db_num, cp.db_size,
+      cp.expire_size, cp.check_sum, cp.check_sum_partial ? 1 : 0, cp.keys);
+  for (const AuxKV &aux : cp.aux_fields) {
+    fprintf(f, "aux %s %s\n", ToHex(aux.aux_key).c_str(), ToHex(aux.aux_val).c_str());
+  }
+  // the rename must not be persisted before the content
+  bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+  if (fclose(f) != 0 || !ok) {
+    return Status::IOError(tmp, strerror(errno));
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    return Status::IOError(path, strerror(errno));
+  }
+  return Status::OK();
+}
+
+Status ReadCheckpoint(const std::string &path, ParseCheckpoint *cp) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL) {
+    return errno == ENOENT ? Status::NotFound(path, "no checkpoint")
+      : Status::IOError(path, strerror(errno));
+  }
+  *cp = ParseCheckpoint();
+  char line[64 << 10];
+  Status s;
+  if (fgets(line, sizeof(line), f) == NULL
+      || strncmp(line, kCheckpointMagic, strlen(kCheckpointMagic)) != 0) {
+    s = Status::Corruption(path, "not a checkpoint file");
+  }
+  while (s.ok() && fgets(line, sizeof(line), f) != NULL) {
+    char name[32], a[sizeof(line)], b[sizeof(line)];
+    unsigned long v = 0;
+    bool ok = true;
+    if (sscanf(line, "aux %s %s", a, b) == 2) {
+      AuxKV aux;
+      ok = FromHex(a, &aux.aux_key) && FromHex(b, &aux.aux_val);
+      cp->aux_fields.push_back(aux);
+    } else if (sscanf(line, "%31s %lu", name, &v) == 2) {
+      std::string field(name);
+      if (field == "version") cp->version = static_cast<int>(v);
+      else if (field == "offset") cp->offset = v;
+      else if (field == "file_size") cp->file_size = v;
+      else if (field == "db_num") cp->db_num = static_cast<uint32_t>(v);
+      else if (field == "db_size") cp->db_size = static_cast<uint32_t>(v);
+      else if (field == "expire_size") cp->expire_size = static_cast<uint32_t>(v);
+      else if (field == "check_sum") cp->check_sum = v;
+      else if (field == "check_sum_partial") cp->check_sum_partial = v != 0;
+      else if (field == "keys") cp->keys = v;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      s = Status::Corruption(path, "bad checkpoint line");
+    }
+  }
+  fclose(f);
+  if (s.ok() && (cp->version <= 0 || cp->offset == 0)) {
+    s = Status::Corruption(path, "incomplete checkpoint");
+  }
+  return s;
+}
+
+}
@@ -0,0 +1,60 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "include/parse_progress.h"
+
+namespace parser {
+
+Status WritePrometheusTextfile(const std::string &path, const ParseProgress &p) {
+  std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (f == NULL) {
+    return Status::IOError(tmp, strerror(errno));
+  }
+  // label values escape backslash, quote and newline
+  std::string file;
+  for (char c : p.path) {
+    if (c == '\\' || c == '"') {
+      file.push_back('\\');
+      file.push_back(c);
+    } else if (c == '\n') {
+      file.append("\\n");
+    } else {
+      file.push_back(c);
+    }
+  }
+  static const struct {
+    const char *name;
+    const char *type;
+    const char *help;
+  } kMetrics[] = {
+    {"rdbparse_offset_bytes", "gauge", "Bytes of the rdb file parsed so far."},
+    {"rdbparse_size_bytes", "gauge", "Size of the rdb file."},
+    {"rdbparse_keys_total", "counter", "Keys parsed so far."},
+    {"rdbparse_elapsed_seconds", "gauge", "Time since the parse started."},
+    {"rdbparse_bytes_per_second", "gauge", "Average parse throughput."},
+    {"rdbparse_keys_per_second", "gauge", "Average keys parsed per second."},
+    {"rdbparse_eta_seconds", "gauge", "Estimated seconds left, -1 if unknown."},
+    {"rdbparse_done", "gauge", "1 once the whole file was parsed."},
+  };
+  const double values[] = {
+    static_cast<double>(p.offset), static_cast<double>(p.total_bytes),
+    static_cast<double>(p.keys), p.elapsed_secs, p.bytes_per_sec,
+    p.keys_per_sec, p.eta_secs, p.done ? 1.0 : 0.0
+  };
+  for (size_t i = 0; i < sizeof(kMetrics) / sizeof(kMetrics[0]); i++) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s %s\n%s{file=\"%s\"} %.17g\n",
+        kMetrics[i].name, kMetrics[i].help, kMetrics[i].name, kMetrics[i].type,
+        kMetrics[i].name, file.c_str(), values[i]);
+  }
+  if (fclose(f) != 0) {
+    return Status::IOError(tmp, strerror(errno));
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    return Status::IOError(path, strerror(errno));
+  }
+  return Status::OK();
+}
+
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "include/parse_stats.h"
+
+namespace parser {
+
+void ParseStats::Reset() {
+  memset(this, 0, sizeof(*this));
+}
+
+uint64_t ParseStats::TimerNanos(int timer) const {
+  if (timer < 0 || timer >= kNumTimers || timer_samples[timer] == 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(static_cast<double>(timer_sampled_nanos[timer])
+      * timer_calls[timer] / timer_samples[timer]);
+}
+
+const char *ParseStats::TimerName(int timer) {
+  static const char *kNames[kNumTimers] = {
+    "io", "crc", "lzf", "ziplist", "intset", "build"
+  };
+  return timer >= 0 && timer < kNumTimers ? kNames[timer] : "";
+}
+
+std::string ParseStats::ToString() const {
+  static const char *kEncodings[kNumStringEncodings] = {
+    "raw", "int8", "int16", "int32", "lzf"
+  };
+  char buf[256];
+  std::string out;
+  snprintf(buf, sizeof(buf), "bytes_read: %lu, read_calls: %lu, skipped_bytes: %lu, "
+      "checksum_bytes: %lu\n", bytes_read, read_calls, skipped_bytes, checksum_bytes);
+  out.append(buf);
+  snprintf(buf, sizeof(buf), "lzf_bytes_in: %lu, lzf_bytes_out: %lu, "
+      "allocations: %lu, keys: %lu, expired_keys: %lu\n", lzf_bytes_in, lzf_bytes_out,
+      allocations, keys, expired_keys);
+  out.append(buf);
+  out.append("keys_per_type:");
+  for (int i = 0; i < kMaxTypes; i++) {
+    if (keys_per_type[i]) {
+      snprintf(buf, sizeof(buf), " %d=%lu", i, keys_per_type[i]);
+      out.append(buf);
+    }
+  }
+  out.append("\nstrings_per_encoding:");
+  for (int i = 0; i < kNumStringEncodings; i++) {
+    snprintf(buf, sizeof(buf), " %s=%lu", kEncodings[i], strings_per_encoding[i]);
+    out.append(buf);
+  }
+  out.append("\n");
+  for (int i = 0; i < kNumTimers; i++) {
+    snprintf(buf, sizeof(buf), "%s: %lu calls, %.3f ms\n", TimerName(i),
+        timer_calls[i], TimerNanos(i) / 1e6);
+    out.append(buf);
+  }
+  return out;
+}
+
+}
@@ -0,0 +1,23 @@
+#include "include/rdb_dump.h"
+#include "util.h"
+
+namespace parser {
+
+void CreateDumpPayload(uint8_t rdb_type, const Slice &raw_value,
+    int rdb_version, std::string *payload) {
+  payload->clear();
+  payload->reserve(1 + raw_value.size() + 2 + 8);
+  payload->push_back(static_cast<char>(rdb_type));
+  payload->append(raw_value.data(), raw_value.size());
+  payload->push_back(static_cast<char>(rdb_version & 0xff));
+  payload->push_back(static_cast<char>((rdb_version >> 8) & 0xff));
+
+  uint64_t crc = crc64(0, reinterpret_cast<const unsigned char *>(payload->data()),
+      payload->size());
+  // the trailer is stored little endian like the version
+  for (int i = 0; i < 8; i++) {
+    payload->push_back(static_cast<char>((crc >> (8 * i)) & 0xff));
+  }
+}
+
+}
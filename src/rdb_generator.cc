@@ -0,0 +1,904 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "rdb_generator.h"
+#include "include/rdb_writer.h"
+#include "rdbparse_impl.h"
+#include "lzf.h"
+#include "ziplist.h"
+#include "numeric.h"
+#include "util.h"
+
+namespace parser {
+
+static const char *kTypeNames[kGeneratorTypes] = {
+  "string", "list", "set", "zset", "hash", "zset2", "", "module2",
+  "", "hash_zipmap", "list_ziplist", "intset", "zset_ziplist",
+  "hash_ziplist", "quicklist", "stream", "hash_listpack", "zset_listpack",
+  "quicklist2", "stream2", "set_listpack", "stream3"
+};
+// Oldest rdb version able to hold each value type, 0 for types the
+// generator never writes.
+static const int kMinVersion[kGeneratorTypes] = {
+  1, 1, 1, 1, 1, 8, 0, 8, 0, 1, 1, 2, 1, 1, 7, 9, 10, 10, 10, 10, 11, 11
+};
+
+static const char *kPhrases[] = {
+  "the quick brown fox jumps over the lazy dog ",
+  "user:session:token:",
+  "{\"id\":1024,\"name\":\"",
+  "0000000000000000",
+  "http://example.com/path/to/resource?q=",
+  "lorem ipsum dolor sit amet, consectetur ",
+  "ERROR WARN INFO DEBUG ",
+  "abcabcabcabcabcabcabcabc",
+};
+static const char kAlnum[] =
+  "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+const char *GeneratorTypeName(int type) {
+  return type >= 0 && type < kGeneratorTypes ? kTypeNames[type] : "";
+}
+
+uint64_t ParseSize(const char *arg) {
+  char *end;
+  uint64_t v = strtoull(arg, &end, 10);
+  switch (*end) {
+    case 'G': case 'g':
+      v <<= 10;
+      // fall through
+    case 'M': case 'm':
+      v <<= 10;
+      // fall through
+    case 'K': case 'k':
+      v <<= 10;
+  }
+  return v;
+}
+
+GeneratorOptions::GeneratorOptions()
+  : seed(1), target_bytes(64 << 20), max_keys(0), rdb_version(9), databases(1),
+    size_dist(kSizeExponential), size_min(1), size_mean(32), size_max(4096),
+    elements_dist(kSizeExponential), elements_min(1), elements_mean(32),
+    elements_max(1024), node_entries(64), compressibility(0.5), compress(true),
+    int_ratio(0.2), expire_ratio(0.3), expired_ratio(0.3),
+    now_ms(1700000000000LL), lru_ratio(0.1) {
+  static const uint32_t kDefaultWeights[kGeneratorTypes] = {
+    40, 2, 2, 2, 4, 4, 0, 1, 0, 1, 2, 6, 8, 16, 8, 2, 16, 8, 8, 1, 4, 1
+  };
+  memcpy(type_weights, kDefaultWeights, sizeof(type_weights));
+}
+
+Status GeneratorOptions::SetTypeWeights(const std::string &spec) {
+  uint32_t weights[kGeneratorTypes] = {0};
+  size_t pos = 0;
+  while (pos < spec.size()) {
+    size_t end = spec.find(',', pos);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string item = spec.substr(pos, end - pos);
+    size_t eq = item.find('=');
+    std::string name = item.substr(0, eq);
+    long weight = 1;
+    if (eq != std::string::npos
+        && !string2l(item.data() + eq + 1, item.size() - eq - 1, &weight)) {
+      return Status::InvalidArgument("bad type weight", item);
+    }
+    int type = 0;
+    while (type < kGeneratorTypes && (kTypeNames[type][0] == '\0'
+          || name != kTypeNames[type])) {
+      type++;
+    }
+    if (type == kGeneratorTypes || weight < 0) {
+      return Status::InvalidArgument("unknown type", item);
+    }
+    weights[type] = static_cast<uint32_t>(weight);
+    pos = end + 1;
+  }
+  memcpy(type_weights, weights, sizeof(type_weights));
+  return Status::OK();
+}
+
+GeneratorStats::GeneratorStats()
+  : keys(0), bytes(0), expires(0), expired(0), elements(0) {
+  memset(keys_per_type, 0, sizeof(keys_per_type));
+}
+
+// Encoders appending the on-disk form of values to a buffer.
+namespace {
+
+void AppendLength(uint64_t len, std::string *out) {
+  char buf[9];
+  out->append(buf, EncodeLength(len, buf));
+}
+
+void AppendRawString(const Slice &s, std::string *out) {
+  AppendLength(s.size(), out);
+  out->append(s.data(), s.size());
+}
+
+void AppendLittleEndian(uint64_t v, int bytes, std::string *out) {
+  for (int i = 0; i < bytes; i++) {
+    out->push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+  }
+}
+
+// Parse |s| as an integer only if it prints back to the same bytes, the
+// condition redis uses before storing a string as an integer.
+bool ToInteger(const Slice &s, int64_t *v) {
+  long long ll;
+  if (s.size() == 0 || s.size() > 20 || !string2ll(s.data(), s.size(), &ll)) {
+    return false;
+  }
+  *v = ll;
+  char buf[20];
+  return Slice(buf, FormatInt64(ll, buf)) == s;
+}
+
+// rdbSaveRawString: integer encoding for short numbers, LZF for strings
+// longer than 20 bytes when it saves at least 4 bytes.
+void AppendString(const Slice &s, bool compress, std::string *scratch,
+    std::string *out) {
+  int64_t v;
+  if (s.size() <= 11 && ToInteger(s, &v)) {
+    if (v >= INT8_MIN && v <= INT8_MAX) {
+      out->push_back(static_cast<char>(0xc0 | RdbParseImpl::kEncInt8));
+      AppendLittleEndian(v, 1, out);
+      return;
+    } else if (v >= INT16_MIN && v <= INT16_MAX) {
+      out->push_back(static_cast<char>(0xc0 | RdbParseImpl::kEncInt16));
+      AppendLittleEndian(v, 2, out);
+      return;
+    } else if (v >= INT32_MIN && v <= INT32_MAX) {
+      out->push_back(static_cast<char>(0xc0 | RdbParseImpl::kEncInt32));
+      AppendLittleEndian(v, 4, out);
+      return;
+    }
+  }
+  if (compress && s.size() > 20) {
+    scratch->resize(s.size() - 4);
+    unsigned int n = CompressLzf(s.data(), s.size(), &(*scratch)[0], s.size() - 4);
+    if (n > 0) {
+      out->push_back(static_cast<char>(0xc0 | RdbParseImpl::kEncLzf));
+      AppendLength(n, out);
+      AppendLength(s.size(), out);
+      out->append(scratch->data(), n);
+      return;
+    }
+  }
+  AppendRawString(s, out);
+}
+
+int FormatDouble(double d, char *buf, size_t size) {
+  if (d == floor(d) && fabs(d) < 1e15) {
+    return snprintf(buf, size, "%lld", static_cast<long long>(d));
+  }
+  return snprintf(buf, size, "%.17g", d);
+}
+
+class ZiplistBuilder {
+  public:
+    void Reset() {
+      buf_.assign(10, '\0');
+      prevlen_ = 0;
+      tail_ = 10;
+      count_ = 0;
+    }
+    void Add(const Slice &s) {
+      size_t start = buf_.size();
+      tail_ = start;
+      if (prevlen_ < 254) {
+        buf_.push_back(static_cast<char>(prevlen_));
+      } else {
+        buf_.push_back(static_cast<char>(kZiplistBegin));
+        AppendLittleEndian(prevlen_, 4, &buf_);
+      }
+      int64_t v;
+      if (ToInteger(s, &v)) {
+        AddInt(v);
+      } else if (s.size() < (1 << 6)) {
+        buf_.push_back(static_cast<char>(kStrEnc6B | s.size()));
+        buf_.append(s.data(), s.size());
+      } else if (s.size() < (1 << 14)) {
+        buf_.push_back(static_cast<char>(kStrEnc14B | (s.size() >> 8)));
+        buf_.push_back(static_cast<char>(s.size() & 0xff));
+        buf_.append(s.data(), s.size());
+      } else {
+        buf_.push_back(static_cast<char>(kStrEnc32B));
+        for (int i = 3; i >= 0; i--) {
+          buf_.push_back(static_cast<char>((s.size() >> (8 * i)) & 0xff));
+        }
+        buf_.append(s.data(), s.size());
+      }
+      prevlen_ = buf_.size() - start;
+      count_++;
+    }
+    const std::string &Finish() {
+      buf_.push_back(static_cast<char>(kZiplistEnd));
+      std::string header;
+      AppendLittleEndian(buf_.size(), 4, &header);
+      AppendLittleEndian(tail_, 4, &header);
+      AppendLittleEndian(count_ < 65535 ? count_ : 65535, 2, &header);
+      buf_.replace(0, header.size(), header);
+      return buf_;
+    }
+  private:
+    void AddInt(int64_t v) {
+      if (v >= 0 && v <= 12) {
+        buf_.push_back(static_cast<char>(0xf1 + v));
+      } else if (v >= INT8_MIN && v <= INT8_MAX) {
+        buf_.push_back(static_cast<char>(kIntEnc8));
+        AppendLittleEndian(v, 1, &buf_);
+      } else if (v >= INT16_MIN && v <= INT16_MAX) {
+        buf_.push_back(static_cast<char>(kIntEnc16));
+        AppendLittleEndian(v, 2, &buf_);
+      } else if (v >= -(1 << 23) && v < (1 << 23)) {
+        buf_.push_back(static_cast<char>(kIntEnc24));
+        AppendLittleEndian(v, 3, &buf_);
+      } else if (v >= INT32_MIN && v <= INT32_MAX) {
+        buf_.push_back(static_cast<char>(kIntEnc32));
+        AppendLittleEndian(v, 4, &buf_);
+      } else {
+        buf_.push_back(static_cast<char>(kIntEnc64));
+        AppendLittleEndian(v, 8, &buf_);
+      }
+    }
+    std::string buf_;
+    size_t prevlen_;
+    size_t tail_;
+    size_t count_;
+};
+
+class ListpackBuilder {
+  public:
+    void Reset() {
+      buf_.assign(6, '\0');
+      count_ = 0;
+    }
+    void AddInt(int64_t v) {
+      size_t start = buf_.size();
+      if (v >= 0 && v <= 127) {
+        buf_.push_back(static_cast<char>(v));
+      } else if (v >= -4096 && v <= 4095) {
+        uint64_t uv = v < 0 ? (1 << 13) + v : v;
+        buf_.push_back(static_cast<char>(0xc0 | (uv >> 8)));
+        buf_.push_back(static_cast<char>(uv & 0xff));
+      } else if (v >= INT16_MIN && v <= INT16_MAX) {
+        buf_.push_back(static_cast<char>(0xf1));
+        AppendLittleEndian(v, 2, &buf_);
+      } else if (v >= -(1 << 23) && v < (1 << 23)) {
+        buf_.push_back(static_cast<char>(0xf2));
+        AppendLittleEndian(v, 3, &buf_);
+      } else if (v >= INT32_MIN && v <= INT32_MAX) {
+        buf_.push_back(static_cast<char>(0xf3));
+        AppendLittleEndian(v, 4, &buf_);
+      } else {
+        buf_.push_back(static_cast<char>(0xf4));
+        AppendLittleEndian(v, 8, &buf_);
+      }
+      AppendBacklen(buf_.size() - start);
+    }
+    void Add(const Slice &s) {
+      int64_t v;
+      if (ToInteger(s, &v)) {
+        AddInt(v);
+        return;
+      }
+      size_t start = buf_.size();
+      if (s.size() < 64) {
+        buf_.push_back(static_cast<char>(0x80 | s.size()));
+      } else if (s.size() < 4096) {
+        buf_.push_back(static_cast<char>(0xe0 | (s.size() >> 8)));
+        buf_.push_back(static_cast<char>(s.size() & 0xff));
+      } else {
+        buf_.push_back(static_cast<char>(0xf0));
+        AppendLittleEndian(s.size(), 4, &buf_);
+      }
+      buf_.append(s.data(), s.size());
+      AppendBacklen(buf_.size() - start);
+    }
+    const std::string &Finish() {
+      buf_.push_back(static_cast<char>(0xff));
+      std::string header;
+      AppendLittleEndian(buf_.size(), 4, &header);
+      AppendLittleEndian(count_ < 65535 ? count_ : 65535, 2, &header);
+      buf_.replace(0, header.size(), header);
+      return buf_;
+    }
+  private:
+    // lpEncodeBacklen: 7 bits per byte, most significant byte first, every
+    // byte but the first has its high bit set
+    void AppendBacklen(uint64_t l) {
+      int bytes = l <= 127 ? 1 : l < 16383 ? 2 : l < 2097151 ? 3
+        : l < 268435455 ? 4 : 5;
+      for (int i = bytes - 1; i >= 0; i--) {
+        uint8_t b = (l >> (7 * i)) & 127;
+        buf_.push_back(static_cast<char>(i == bytes - 1 ? b : (b | 128)));
+      }
+      count_++;
+    }
+    std::string buf_;
+    size_t count_;
+};
+
+}  // namespace
+
+struct RdbGenerator::Rep {
+  explicit Rep(const GeneratorOptions &o) : options(o), rng(o.seed), counter(0) {
+    total_weight = 0;
+    for (int i = 0; i < kGeneratorTypes; i++) {
+      if (kMinVersion[i] == 0 || options.rdb_version < kMinVersion[i]) {
+        options.type_weights[i] = 0;
+      }
+      total_weight += options.type_weights[i];
+    }
+  }
+
+  // splitmix64
+  uint64_t Next() {
+    uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+  uint64_t Uniform(uint64_t n) {
+    return n ? Next() % n : 0;
+  }
+  double NextDouble() {
+    return (Next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+  bool Chance(double p) {
+    return NextDouble() < p;
+  }
+  uint32_t Draw(SizeDistribution dist, uint32_t min, uint32_t mean, uint32_t max) {
+    double v;
+    switch (dist) {
+      case kSizeFixed:
+        return mean;
+      case kSizeUniform:
+        return min + Uniform(max >= min ? max - min + 1 : 1);
+      default:
+        v = min - log(1.0 - NextDouble()) * (mean > min ? mean - min : 1);
+        return v > max ? max : static_cast<uint32_t>(v);
+    }
+  }
+
+  int PickType() {
+    uint64_t r = Uniform(total_weight);
+    for (int i = 0; i < kGeneratorTypes; i++) {
+      if (r < options.type_weights[i]) {
+        return i;
+      }
+      r -= options.type_weights[i];
+    }
+    return kRdbString;
+  }
+
+  int64_t RandomInt() {
+    static const int kBits[] = {4, 8, 16, 24, 32, 64};
+    int bits = kBits[Uniform(6)];
+    int64_t v = static_cast<int64_t>(Next());
+    if (bits < 64) {
+      v = v >> (64 - bits);
+    }
+    return v;
+  }
+
+  void FillBytes(size_t n, std::string *out) {
+    out->clear();
+    while (out->size() < n) {
+      if (Chance(options.compressibility)) {
+        out->append(kPhrases[Uniform(sizeof(kPhrases) / sizeof(kPhrases[0]))]);
+      } else {
+        uint64_t r = Next();
+        for (int i = 0; i < 8; i++, r >>= 8) {
+          out->push_back(kAlnum[(r & 0xff) % (sizeof(kAlnum) - 1)]);
+        }
+      }
+    }
+    out->resize(n);
+  }
+
+  void MakeValue(std::string *out) {
+    if (Chance(options.int_ratio)) {
+      *out = std::to_string(RandomInt());
+      return;
+    }
+    FillBytes(Draw(options.size_dist, options.size_min, options.size_mean,
+          options.size_max), out);
+  }
+
+  // Members of sets, hashes and zsets must be distinct, prefix them with
+  // their position or space integers apart.
+  void MakeMember(size_t i, std::string *out) {
+    if (Chance(options.int_ratio)) {
+      *out = std::to_string(static_cast<int64_t>(i) * 1000 + Uniform(1000));
+      return;
+    }
+    MakeValue(&scratch);
+    *out = "m" + std::to_string(i) + ":" + scratch;
+  }
+
+  double MakeScore() {
+    if (Chance(options.int_ratio)) {
+      return static_cast<double>(RandomInt() >> 12);
+    }
+    return static_cast<int64_t>(Uniform(100000000)) / 1000.0;
+  }
+
+  uint32_t Elements() {
+    uint32_t n = Draw(options.elements_dist, options.elements_min,
+        options.elements_mean, options.elements_max);
+    return n ? n : 1;
+  }
+
+  void AppendElements(uint32_t n, std::string *out) {
+    AppendLength(n, out);
+    for (uint32_t i = 0; i < n; i++) {
+      MakeValue(&elem);
+      AppendString(elem, options.compress, &lzf, out);
+    }
+  }
+
+  void AppendMembers(uint32_t n, int width, std::string *out) {
+    AppendLength(n, out);
+    for (uint32_t i = 0; i < n; i++) {
+      MakeMember(i, &elem);
+      AppendString(elem, options.compress, &lzf, out);
+      if (width == 2) {
+        MakeValue(&elem);
+        AppendString(elem, options.compress, &lzf, out);
+      }
+    }
+  }
+
+  void AppendZset(uint32_t n, bool binary, std::string *out) {
+    char buf[32];
+    AppendLength(n, out);
+    for (uint32_t i = 0; i < n; i++) {
+      MakeMember(i, &elem);
+      AppendString(elem, options.compress, &lzf, out);
+      double score = MakeScore();
+      if (binary) {
+        uint64_t bits;
+        memcpy(&bits, &score, sizeof(bits));
+        AppendLittleEndian(bits, 8, out);
+      } else {
+        int len = snprintf(buf, sizeof(buf), "%.17g", score);
+        out->push_back(static_cast<char>(len));
+        out->append(buf, len);
+      }
+    }
+  }
+
+  void AppendZiplist(uint32_t n, int kind, std::string *out) {
+    char buf[32];
+    ziplist.Reset();
+    for (uint32_t i = 0; i < n; i++) {
+      if (kind == kRdbListZiplist) {
+        MakeValue(&elem);
+        ziplist.Add(elem);
+        continue;
+      }
+      MakeMember(i, &elem);
+      ziplist.Add(elem);
+      if (kind == kRdbZsetZiplist) {
+        ziplist.Add(Slice(buf, FormatDouble(MakeScore(), buf, sizeof(buf))));
+      } else {
+        MakeValue(&elem);
+        ziplist.Add(elem);
+      }
+    }
+    AppendString(ziplist.Finish(), options.compress, &lzf, out);
+  }
+
+  void AppendListpack(uint32_t n, int kind, std::string *out) {
+    char buf[32];
+    listpack.Reset();
+    for (uint32_t i = 0; i < n; i++) {
+      MakeMember(i, &elem);
+      listpack.Add(elem);
+      if (kind == kRdbZsetListpack) {
+        listpack.Add(Slice(buf, FormatDouble(MakeScore(), buf, sizeof(buf))));
+      } else if (kind == kRdbHashListpack) {
+        MakeValue(&elem);
+        listpack.Add(elem);
+      }
+    }
+    AppendString(listpack.Finish(), options.compress, &lzf, out);
+  }
+
+  void AppendIntset(uint32_t n, std::string *out) {
+    static const int kWidths[] = {2, 4, 8};
+    int width = kWidths[Uniform(3)];
+    std::vector<int64_t> values(n);
+    for (uint32_t i = 0; i < n; i++) {
+      int64_t v = static_cast<int64_t>(Next());
+      values[i] = width == 8 ? v : v >> (64 - 8 * width);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    elem.clear();
+    AppendLittleEndian(width, 4, &elem);
+    AppendLittleEndian(values.size(), 4, &elem);
+    for (int64_t v : values) {
+      AppendLittleEndian(v, width, &elem);
+    }
+    AppendString(elem, options.compress, &lzf, out);
+  }
+
+  void AppendZipmap(uint32_t n, std::string *out) {
+    std::string zm;
+    zm.push_back(static_cast<char>(n < 254 ? n : 254));
+    for (uint32_t i = 0; i < n; i++) {
+      for (int kv = 0; kv < 2; kv++) {
+        if (kv == 0) {
+          MakeMember(i, &elem);
+        } else {
+          MakeValue(&elem);
+        }
+        if (elem.size() < 254) {
+          zm.push_back(static_cast<char>(elem.size()));
+        } else {
+          zm.push_back(static_cast<char>(254));
+          AppendLittleEndian(elem.size(), 4, &zm);
+        }
+        uint8_t free_len = 0;
+        if (kv == 1) {
+          free_len = Chance(0.25) ? 1 + Uniform(4) : 0;
+          zm.push_back(static_cast<char>(free_len));
+        }
+        zm.append(elem);
+        zm.append(free_len, '\0');
+      }
+    }
+    zm.push_back(static_cast<char>(0xff));
+    AppendString(zm, options.compress, &lzf, out);
+  }
+
+  void AppendQuicklist(uint32_t n, std::string *out) {
+    uint32_t per_node = options.node_entries ? options.node_entries : 1;
+    uint32_t nodes = (n + per_node - 1) / per_node;
+    AppendLength(nodes, out);
+    for (uint32_t node = 0; node < nodes; node++) {
+      ziplist.Reset();
+      for (uint32_t i = node * per_node; i < n && i < (node + 1) * per_node; i++) {
+        MakeValue(&elem);
+        ziplist.Add(elem);
+      }
+      AppendString(ziplist.Finish(), options.compress, &lzf, out);
+    }
+  }
+
+  // A few nodes hold one element stored plain, as redis does for
+  // elements too large for a listpack.
+  void AppendQuicklist2(uint32_t n, std::string *out) {
+    uint32_t per_node = options.node_entries ? options.node_entries : 1;
+    std::vector<uint32_t> nodes;
+    for (uint32_t i = 0; i < n; i += nodes.back()) {
+      nodes.push_back(Chance(0.05) ? 1 : std::min(per_node, n - i));
+    }
+    AppendLength(nodes.size(), out);
+    for (uint32_t count : nodes) {
+      if (count == 1 && Chance(0.5)) {
+        AppendLength(RdbParseImpl::kQuicklistNodePlain, out);
+        MakeValue(&elem);
+        AppendString(elem, options.compress, &lzf, out);
+        continue;
+      }
+      AppendLength(RdbParseImpl::kQuicklistNodePacked, out);
+      listpack.Reset();
+      for (uint32_t i = 0; i < count; i++) {
+        MakeValue(&elem);
+        listpack.Add(elem);
+      }
+      AppendString(listpack.Finish(), options.compress, &lzf, out);
+    }
+  }
+
+  void AppendModule(std::string *out) {
+    // module id: a 54 bit encoded name and a 10 bit encoding version
+    AppendLength((0x2f1d3c5b7a9ULL << 10) | 1, out);
+    AppendLength(RdbParseImpl::kModuleUint, out);
+    AppendLength(Next() >> 8, out);
+    AppendLength(RdbParseImpl::kModuleString, out);
+    MakeValue(&elem);
+    AppendString(elem, options.compress, &lzf, out);
+    AppendLength(RdbParseImpl::kModuleDouble, out);
+    AppendLittleEndian(Next(), 8, out);
+    AppendLength(RdbParseImpl::kModuleFloat, out);
+    AppendLittleEndian(Next(), 4, out);
+    AppendLength(RdbParseImpl::kModuleEof, out);
+  }
+
+  static void AppendStreamId(uint64_t ms, uint64_t seq, std::string *out) {
+    for (int i = 7; i >= 0; i--) {
+      out->push_back(static_cast<char>((ms >> (8 * i)) & 0xff));
+    }
+    for (int i = 7; i >= 0; i--) {
+      out->push_back(static_cast<char>((seq >> (8 * i)) & 0xff));
+    }
+  }
+
+  void AppendStream(uint32_t n, int type, std::string *out) {
+    uint32_t per_node = options.node_entries ? options.node_entries : 1;
+    uint32_t nodes = (n + per_node - 1) / per_node;
+    uint32_t num_fields = 1 + Uniform(4);
+    std::vector<std::string> fields(num_fields);
+    for (uint32_t f = 0; f < num_fields; f++) {
+      fields[f] = "field" + std::to_string(f);
+    }
+    std::vector<std::pair<uint64_t, uint64_t> > ids;
+    uint64_t ms = options.now_ms - Uniform(86400000), seq = 0;
+
+    AppendLength(nodes, out);
+    for (uint32_t node = 0; node < nodes; node++) {
+      uint32_t count = std::min(per_node, n - node * per_node);
+      uint64_t master_ms = ms, master_seq = seq;
+      std::string key;
+      AppendStreamId(master_ms, master_seq, &key);
+      AppendRawString(key, out);
+
+      listpack.Reset();
+      listpack.AddInt(count);
+      listpack.AddInt(0);
+      listpack.AddInt(num_fields);
+      for (const std::string &f : fields) {
+        listpack.Add(f);
+      }
+      listpack.AddInt(0);
+      for (uint32_t i = 0; i < count; i++) {
+        bool same = Chance(0.7);
+        listpack.AddInt(same ? 2 : 0);
+        listpack.AddInt(ms - master_ms);
+        listpack.AddInt(seq - master_seq);
+        if (!same) {
+          listpack.AddInt(num_fields);
+        }
+        for (uint32_t f = 0; f < num_fields; f++) {
+          if (!same) {
+            listpack.Add("other" + std::to_string(f));
+          }
+          MakeValue(&elem);
+          listpack.Add(elem);
+        }
+        listpack.AddInt(same ? num_fields + 3 : num_fields * 2 + 4);
+        ids.push_back(std::make_pair(ms, seq));
+        if (Chance(0.5)) {
+          ms += 1 + Uniform(1000);
+          seq = 0;
+        } else {
+          seq++;
+        }
+      }
+      AppendString(listpack.Finish(), options.compress, &lzf, out);
+    }
+    AppendLength(n, out);
+    AppendLength(ids.back().first, out);
+    AppendLength(ids.back().second, out);
+    if (type != kRdbStreamListpacks) {
+      // first id, max deleted id and entries added
+      AppendLength(ids.front().first, out);
+      AppendLength(ids.front().second, out);
+      AppendLength(0, out);
+      AppendLength(0, out);
+      AppendLength(n, out);
+    }
+
+    uint32_t groups = Uniform(2);
+    AppendLength(groups, out);
+    for (uint32_t g = 0; g < groups; g++) {
+      AppendRawString("group" + std::to_string(g), out);
+      AppendLength(ids.back().first, out);
+      AppendLength(ids.back().second, out);
+      if (type != kRdbStreamListpacks) {
+        AppendLength(n, out);
+      }
+      uint32_t pending = std::min<uint32_t>(ids.size(), Uniform(4));
+      AppendLength(pending, out);
+      for (uint32_t p = 0; p < pending; p++) {
+        AppendStreamId(ids[p].first, ids[p].second, out);
+        AppendLittleEndian(options.now_ms - Uniform(60000), 8, out);
+        AppendLength(1 + Uniform(3), out);
+      }
+      AppendLength(1, out);
+      AppendRawString("consumer", out);
+      AppendLittleEndian(options.now_ms - Uniform(60000), 8, out);
+      if (type == kRdbStreamListpacks3) {
+        AppendLittleEndian(options.now_ms - Uniform(60000), 8, out);
+      }
+      AppendLength(pending, out);
+      for (uint32_t p = 0; p < pending; p++) {
+        AppendStreamId(ids[p].first, ids[p].second, out);
+      }
+    }
+  }
+
+  // Fill |value| with the encoded value of one key of type |type|.
+  uint32_t MakeEntry(int type, std::string *out) {
+    out->clear();
+    uint32_t n = type == kRdbString ? 1 : Elements();
+    switch (type) {
+      case kRdbString:
+        MakeValue(&elem);
+        AppendString(elem, options.compress, &lzf, out);
+        break;
+      case kRdbList:
+        AppendElements(n, out);
+        break;
+      case kRdbSet:
+        AppendMembers(n, 1, out);
+        break;
+      case kRdbHash:
+        AppendMembers(n, 2, out);
+        break;
+      case kRdbZset:
+      case kRdbZset2:
+        AppendZset(n, type == kRdbZset2, out);
+        break;
+      case kRdbModule2:
+        AppendModule(out);
+        break;
+      case kRdbHashZipmap:
+        AppendZipmap(n, out);
+        break;
+      case kRdbListZiplist:
+      case kRdbZsetZiplist:
+      case kRdbHashZiplist:
+        AppendZiplist(n, type, out);
+        break;
+      case kRdbIntset:
+        AppendIntset(n, out);
+        break;
+      case kRdbListQuicklist:
+        AppendQuicklist(n, out);
+        break;
+      case kRdbStreamListpacks:
+      case kRdbStreamListpacks2:
+      case kRdbStreamListpacks3:
+        AppendStream(n, type, out);
+        break;
+      case kRdbHashListpack:
+      case kRdbZsetListpack:
+      case kRdbSetListpack:
+        AppendListpack(n, type, out);
+        break;
+      case kRdbListQuicklist2:
+        AppendQuicklist2(n, out);
+        break;
+    }
+    return n;
+  }
+
+  Status WriteAuxFields(RdbWriter *writer) {
+    if (options.rdb_version < 7) {
+      return Status::OK();
+    }
+    const std::string aux[][2] = {
+      {"redis-ver", "255.255.255"},
+      {"redis-bits", "64"},
+      {"ctime", std::to_string(options.now_ms / 1000)},
+      {"used-mem", std::to_string(options.target_bytes * 3)},
+      {"aof-preamble", "0"},
+    };
+    std::string buf;
+    for (size_t i = 0; i < sizeof(aux) / sizeof(aux[0]); i++) {
+      buf.push_back(static_cast<char>(RdbParseImpl::kAux));
+      AppendString(aux[i][0], false, &lzf, &buf);
+      AppendString(aux[i][1], false, &lzf, &buf);
+    }
+    return writer->WriteRaw(buf.data(), buf.size());
+  }
+
+  Status WriteKey(RdbWriter *writer, int type, GeneratorStats *stats) {
+    head.clear();
+    if (Chance(options.expire_ratio)) {
+      bool expired = Chance(options.expired_ratio);
+      int64_t delta = 1 + Uniform(30LL * 86400 * 1000);
+      int64_t expire_ms = options.now_ms + (expired ? -delta : delta);
+      head.push_back(static_cast<char>(RdbParseImpl::kExpireMs));
+      AppendLittleEndian(expire_ms, 8, &head);
+      stats->expires++;
+      stats->expired += expired ? 1 : 0;
+    }
+    if (options.rdb_version >= 9 && Chance(options.lru_ratio)) {
+      if (Chance(0.5)) {
+        head.push_back(static_cast<char>(RdbParseImpl::kIdle));
+        AppendLength(Uniform(1 << 20), &head);
+      } else {
+        head.push_back(static_cast<char>(RdbParseImpl::kFreq));
+        head.push_back(static_cast<char>(Uniform(256)));
+      }
+    }
+    head.push_back(static_cast<char>(type));
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "t%02u:%s:%llu",
+        static_cast<unsigned>(Uniform(32)), kTypeNames[type],
+        static_cast<unsigned long long>(counter++));
+    AppendString(Slice(buf, len), options.compress, &lzf, &head);
+    stats->elements += MakeEntry(type, &value);
+
+    Status s = writer->WriteRaw(head.data(), head.size());
+    if (s.ok()) {
+      s = writer->WriteRaw(value.data(), value.size());
+    }
+    stats->keys++;
+    stats->keys_per_type[type]++;
+    return s;
+  }
+
+  GeneratorOptions options;
+  uint64_t rng;
+  uint64_t total_weight;
+  uint64_t counter;
+  ZiplistBuilder ziplist;
+  ListpackBuilder listpack;
+  std::string head, value, elem, scratch, lzf;
+};
+
+RdbGenerator::RdbGenerator(const GeneratorOptions &options)
+  : rep_(new Rep(options)) {
+}
+
+RdbGenerator::~RdbGenerator() {
+  delete rep_;
+}
+
+Status RdbGenerator::Generate(const std::string &path, GeneratorStats *stats) {
+  RdbWriter *writer;
+  Status s = RdbWriter::Open(path, RdbWriterOptions(), &writer);
+  if (!s.ok()) {
+    return s;
+  }
+  s = Generate(writer, stats);
+  if (s.ok()) {
+    s = writer->Finish();
+    stats->bytes = writer->bytes_written();
+  }
+  delete writer;
+  return s;
+}
+
+Status RdbGenerator::Generate(RdbWriter *writer, GeneratorStats *stats) {
+  Rep *r = rep_;
+  const GeneratorOptions &o = r->options;
+  if (r->total_weight == 0) {
+    return Status::InvalidArgument("no value type can be generated");
+  }
+  uint64_t target = o.target_bytes;
+  if (target == 0 && o.max_keys == 0) {
+    target = GeneratorOptions().target_bytes;
+  }
+  uint32_t databases = o.databases ? o.databases : 1;
+
+  Status s = writer->WriteHeader(o.rdb_version);
+  if (s.ok()) {
+    s = r->WriteAuxFields(writer);
+  }
+  for (uint32_t db = 0; db < databases && s.ok(); db++) {
+    uint64_t db_target = target / databases * (db + 1);
+    uint64_t db_keys = o.max_keys / databases * (db + 1);
+    if (db + 1 == databases) {
+      db_target = target;
+      db_keys = o.max_keys;
+    }
+    s = writer->WriteSelectDb(db);
+    if (s.ok() && o.rdb_version >= 7) {
+      s = writer->WriteResizeDb(o.max_keys / databases,
+          static_cast<uint64_t>(o.max_keys / databases * o.expire_ratio));
+    }
+    while (s.ok() && (target == 0 || writer->bytes_written() < db_target)
+        && (o.max_keys == 0 || stats->keys < db_keys)) {
+      s = r->WriteKey(writer, r->PickType(), stats);
+    }
+  }
+  stats->bytes = writer->bytes_written();
+  return s;
+}
+
+}
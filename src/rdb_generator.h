@@ -0,0 +1,102 @@
+#ifndef __RDB_GENERATOR_H__
+#define __RDB_GENERATOR_H__
+
+#include <stdint.h>
+#include <string>
+#include "include/status.h"
+#include "include/slice.h"
+
+namespace parser {
+
+class RdbWriter;
+
+// Number of value types the generator knows, indexed by ValueType.
+static const int kGeneratorTypes = 22;
+
+enum SizeDistribution {
+  kSizeFixed = 0,       // always size_mean
+  kSizeUniform,         // uniform in [size_min, size_max]
+  kSizeExponential      // size_min plus an exponential tail, capped at size_max
+};
+
+struct GeneratorOptions {
+  GeneratorOptions();
+
+  // Same seed and options, same bytes.
+  uint64_t seed;
+  // Stop once the file holds this many bytes or keys, 0 means no limit.
+  uint64_t target_bytes;
+  uint64_t max_keys;
+  int rdb_version;
+  uint32_t databases;
+  // Relative weight of every value type, indexed by ValueType. Types the
+  // rdb_version cannot hold are never generated.
+  uint32_t type_weights[kGeneratorTypes];
+
+  // Size of string values and collection elements.
+  SizeDistribution size_dist;
+  uint32_t size_min;
+  uint32_t size_mean;
+  uint32_t size_max;
+  // Elements per collection, drawn with the same kind of distribution.
+  SizeDistribution elements_dist;
+  uint32_t elements_min;
+  uint32_t elements_mean;
+  uint32_t elements_max;
+  // Entries per quicklist node and per stream listpack.
+  uint32_t node_entries;
+
+  // Share of value bytes taken from a small phrase table, 0 gives random
+  // alphanumerics that LZF cannot shrink, 1 highly repetitive values.
+  double compressibility;
+  // LZF compress strings longer than 20 bytes, as rdbcompression does.
+  bool compress;
+  // Share of values and elements that are integers.
+  double int_ratio;
+  // Share of keys with a TTL, and of those the share already expired at
+  // now_ms.
+  double expire_ratio;
+  double expired_ratio;
+  int64_t now_ms;
+  // Share of keys preceded by an LRU idle or LFU freq opcode.
+  double lru_ratio;
+
+  // Set type_weights from "name=weight,..." using the names of
+  // GeneratorTypeName, every type not listed gets weight 0.
+  Status SetTypeWeights(const std::string &spec);
+};
+
+// Name used for a value type by SetTypeWeights, "" for unknown types.
+const char *GeneratorTypeName(int type);
+// A byte count with an optional K, M or G suffix, for -s style flags.
+uint64_t ParseSize(const char *arg);
+
+struct GeneratorStats {
+  GeneratorStats();
+  uint64_t keys;
+  uint64_t bytes;
+  uint64_t expires;
+  uint64_t expired;
+  uint64_t elements;
+  uint64_t keys_per_type[kGeneratorTypes];
+};
+
+// Writes deterministic synthetic rdb files exercising every value type and
+// encoding the parser understands.
+class RdbGenerator {
+  public:
+    explicit RdbGenerator(const GeneratorOptions &options);
+    ~RdbGenerator();
+
+    Status Generate(const std::string &path, GeneratorStats *stats);
+    Status Generate(RdbWriter *writer, GeneratorStats *stats);
+
+    RdbGenerator(const RdbGenerator&) = delete;
+    RdbGenerator& operator=(const RdbGenerator&) = delete;
+  private:
+    struct Rep;
+    Rep *rep_;
+};
+
+}
+#endif
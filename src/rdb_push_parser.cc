@@ -0,0 +1,84 @@
+#include "include/rdb_push_parser.h"
+#include "rdbparse_impl.h"
+#include "util.h"
+
+namespace parser {
+
+RdbPushParser::RdbPushParser(const ParseOptions &options)
+  : buffer_(new BufferSequentialFile), impl_(new RdbParseImpl(buffer_, options)),
+    header_done_(false), done_(false), retry_at_(0) {
+}
+
+RdbPushParser::~RdbPushParser() {
+  delete impl_;  // owns buffer_
+}
+
+Status RdbPushParser::Feed(const char *data, size_t n,
+    std::vector<ParsedResult> *records) {
+  if (done_) {
+    return Status::OK();
+  }
+  buffer_->Append(data, n);
+  return Parse(false, records);
+}
+
+Status RdbPushParser::Finish(std::vector<ParsedResult> *records) {
+  if (done_) {
+    return Status::OK();
+  }
+  Status s = Parse(true, records);
+  if (s.ok() && !done_) {
+    return Status::Incomplete("rdb stream ended before EOF");
+  }
+  return s;
+}
+
+Status RdbPushParser::Parse(bool force, std::vector<ParsedResult> *records) {
+  while (!done_) {
+    if (!force && buffer_->available() < retry_at_) {
+      return Status::OK();
+    }
+    Status s = header_done_ ? impl_->TryNext() : impl_->TryInit();
+    if (s.IsIncomplete()) {
+      // nothing changes before the failed read can succeed
+      retry_at_ = buffer_->needed();
+      return force ? s : Status::OK();
+    }
+    if (!s.ok()) {
+      return s;
+    }
+    retry_at_ = 0;
+    force = false;
+    if (!header_done_) {
+      header_done_ = true;
+      continue;
+    }
+    if (!impl_->Valid()) {
+      done_ = true;
+      break;
+    }
+    ParsedResult *result = impl_->Value();
+    if (!result->key.empty()) {
+      records->push_back(std::move(*result));
+    }
+  }
+  return Status::OK();
+}
+
+int RdbPushParser::Version() const {
+  return header_done_ ? impl_->Version() : 0;
+}
+
+const std::vector<AuxKV> &RdbPushParser::AuxFields() {
+  return impl_->AuxFields();
+}
+
+const ParseStats *RdbPushParser::Stats() {
+  return impl_->Stats();
+}
+
+uint64_t RdbPushParser::buffered() const {
+  return buffer_->available();
+}
+
+}
@@ -0,0 +1,380 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "include/rdb_replication.h"
+#include "include/rdb_push_parser.h"
+#include "include/resp_exporter.h"
+#include "numeric.h"
+#include "util.h"
+
+namespace parser {
+
+static const size_t kEofMarkLength = 40;
+static const size_t kReadSize = 64 * 1024;
+
+// Returns 1 when a complete command starts at |p|, 0 when more bytes are
+// needed and -1 when the bytes are not RESP. A lone newline, sent by the
+// master to keep the link alive, is consumed with an empty |argv|.
+static int ParseCommand(const char *p, size_t n, size_t *used,
+    std::vector<std::string> *argv) {
+  argv->clear();
+  if (n == 0) {
+    return 0;
+  }
+  if (p[0] == '\n') {
+    *used = 1;
+    return 1;
+  }
+  if (p[0] != '*') {
+    return -1;
+  }
+  const char *eol = static_cast<const char *>(memchr(p, '\n', n));
+  if (eol == NULL) {
+    return 0;
+  }
+  size_t off = eol - p + 1;
+  long long argc = 0;
+  if (off < 4 || !string2ll(p + 1, off - 3, &argc) || argc < 0) {
+    return -1;
+  }
+  for (long long i = 0; i < argc; i++) {
+    if (off >= n) {
+      return 0;
+    }
+    if (p[off] != '$') {
+      return -1;
+    }
+    eol = static_cast<const char *>(memchr(p + off, '\n', n - off));
+    if (eol == NULL) {
+      return 0;
+    }
+    size_t line = eol - (p + off) + 1;
+    long long len = 0;
+    if (line < 4 || !string2ll(p + off + 1, line - 3, &len) || len < 0) {
+      return -1;
+    }
+    off += line;
+    if (n - off < static_cast<uint64_t>(len) + 2) {
+      return 0;
+    }
+    argv->push_back(std::string(p + off, len));
+    off += len + 2;
+  }
+  *used = off;
+  return 1;
+}
+
+ReplicationSource::ReplicationSource(const ReplicationOptions &options)
+  : options_(options), fd_(-1), rpos_(0), parser_(new RdbPushParser(options.parse)),
+    offset_(-1), snapshot_bytes_(0), snapshot_done_(false) {
+}
+
+ReplicationSource::~ReplicationSource() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  delete parser_;
+}
+
+Status ReplicationSource::Open(const std::string &host, int port,
+    const ReplicationOptions &options, ReplicationSource **source) {
+  *source = nullptr;
+  ReplicationSource *impl = new ReplicationSource(options);
+  Status s = TcpConnect(host, port, &impl->fd_);
+  if (s.ok()) {
+    s = impl->Handshake();
+  }
+  if (!s.ok()) {
+    delete impl;
+    return s;
+  }
+  *source = impl;
+  return Status::OK();
+}
+
+Status ReplicationSource::SendCommand(const std::vector<std::string> &argv) {
+  std::string out;
+  RespEncoder::AppendCommand(std::vector<Slice>(argv.begin(), argv.end()), &out);
+  size_t pos = 0;
+  while (pos < out.size()) {
+    ssize_t w = write(fd_, out.data() + pos, out.size() - pos);
+    if (w >= 0) {
+      pos += w;
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      return Status::IOError("write", strerror(errno));
+    }
+    struct pollfd pfd = {fd_, POLLOUT, 0};
+    int r = poll(&pfd, 1, options_.timeout_ms);
+    if (r == 0) {
+      return Status::Timeout("master does not read");
+    }
+    if (r < 0 && errno != EINTR) {
+      return Status::IOError("poll", strerror(errno));
+    }
+  }
+  return Status::OK();
+}
+
+// Read more bytes into rbuf_, waiting up to |wait_ms| for them.
+Status ReplicationSource::Fill(int wait_ms) {
+  if (rpos_ > 0 && (rpos_ >= (1 << 20) || rpos_ * 2 >= rbuf_.size())) {
+    rbuf_.erase(0, rpos_);
+    rpos_ = 0;
+  }
+  while (true) {
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int r = poll(&pfd, 1, wait_ms);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError("poll", strerror(errno));
+    }
+    if (r == 0) {
+      return Status::Timeout("no data from master");
+    }
+    char buf[kReadSize];
+    ssize_t n = read(fd_, buf, sizeof(buf));
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        continue;
+      }
+      return Status::IOError("read", strerror(errno));
+    }
+    if (n == 0) {
+      return Status::EndFile("replication link closed by master");
+    }
+    rbuf_.append(buf, n);
+    return Status::OK();
+  }
+}
+
+Status ReplicationSource::ReadLine(std::string *line) {
+  while (true) {
+    const char *begin = rbuf_.data() + rpos_;
+    const char *eol = static_cast<const char *>(
+        memchr(begin, '\n', rbuf_.size() - rpos_));
+    if (eol != NULL) {
+      size_t len = eol - begin;
+      if (len > 0 && begin[len - 1] == '\r') {
+        len--;
+      }
+      line->assign(begin, len);
+      rpos_ += eol - begin + 1;
+      return Status::OK();
+    }
+    Status s = Fill(options_.timeout_ms);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+}
+
+Status ReplicationSource::Handshake() {
+  std::string reply;
+  Status s;
+  if (!options_.password.empty()) {
+    s = SendCommand({"AUTH", options_.password});
+    if (s.ok()) {
+      s = ReadLine(&reply);
+    }
+    if (s.ok() && reply[0] != '+') {
+      return Status::AuthFailed("AUTH", reply);
+    }
+  }
+  // Older masters reject REPLCONF, the sync still works without it.
+  if (s.ok() && options_.listening_port > 0) {
+    s = SendCommand({"REPLCONF", "listening-port",
+        std::to_string(options_.listening_port)});
+    if (s.ok()) {
+      s = ReadLine(&reply);
+    }
+  }
+  if (s.ok()) {
+    s = SendCommand({"REPLCONF", "capa", "eof", "capa", "psync2"});
+  }
+  if (s.ok()) {
+    s = ReadLine(&reply);
+  }
+  if (s.ok() && options_.psync) {
+    s = SendCommand({"PSYNC", "?", "-1"});
+    do {
+      if (s.ok()) {
+        s = ReadLine(&reply);
+      }
+    } while (s.ok() && reply.empty());
+    if (!s.ok()) {
+      return s;
+    }
+    if (reply.compare(0, 12, "+FULLRESYNC ") == 0) {
+      size_t sp = reply.find(' ', 12);
+      long long offset = 0;
+      if (sp == std::string::npos
+          || !string2ll(reply.data() + sp + 1, reply.size() - sp - 1, &offset)) {
+        return Status::Corruption("bad FULLRESYNC reply", reply);
+      }
+      replid_ = reply.substr(12, sp - 12);
+      offset_ = offset;
+      return Status::OK();
+    }
+    if (reply[0] == '+') {
+      return Status::Corruption("unexpected PSYNC reply", reply);
+    }
+  }
+  if (s.ok()) {
+    s = SendCommand({"SYNC"});
+  }
+  return s;
+}
+
+Status ReplicationSource::ReadSnapshot(const RecordCallback &cb) {
+  if (snapshot_done_) {
+    return Status::OK();
+  }
+  std::string header;
+  Status s;
+  do {
+    s = ReadLine(&header);
+  } while (s.ok() && header.empty());
+  if (!s.ok()) {
+    return s;
+  }
+  if (header[0] == '-') {
+    return Status::IOError("master refused the sync", header.substr(1));
+  }
+  std::string eof_mark;
+  long long length = 0;
+  if (header.compare(0, 5, "$EOF:") == 0 && header.size() == 5 + kEofMarkLength) {
+    eof_mark = header.substr(5);
+  } else if (header[0] != '$'
+      || !string2ll(header.data() + 1, header.size() - 1, &length) || length < 0) {
+    return Status::Corruption("bad bulk header", header);
+  }
+
+  std::vector<ParsedResult> records;
+  bool framed_end = false;
+  while (s.ok() && !framed_end) {
+    const char *begin = rbuf_.data() + rpos_;
+    size_t avail = rbuf_.size() - rpos_;
+    size_t n = avail;
+    if (eof_mark.empty()) {
+      uint64_t left = length - snapshot_bytes_;
+      if (n >= left) {
+        n = left;
+        framed_end = true;
+      }
+    } else {
+      const char *mark = static_cast<const char *>(
+          memmem(begin, avail, eof_mark.data(), eof_mark.size()));
+      if (mark != NULL) {
+        n = mark - begin;
+        framed_end = true;
+      } else {
+        // the mark may have started in the bytes held back
+        n = avail < kEofMarkLength ? 0 : avail - (kEofMarkLength - 1);
+      }
+    }
+    if (n > 0) {
+      s = parser_->Feed(begin, n, &records);
+    }
+    rpos_ += n;
+    snapshot_bytes_ += n;
+    if (framed_end && eof_mark.size()) {
+      rpos_ += kEofMarkLength;
+    }
+    if (s.ok() && framed_end) {
+      s = parser_->Finish(&records);
+    }
+    for (size_t i = 0; s.ok() && i < records.size(); i++) {
+      s = cb(&records[i]);
+    }
+    records.clear();
+    if (s.ok() && !framed_end) {
+      s = Fill(options_.timeout_ms);
+    }
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  snapshot_done_ = true;
+  // A diskless master only starts streaming commands after the first ACK.
+  return offset_ >= 0 ? SendAck() : Status::OK();
+}
+
+Status ReplicationSource::SendAck() {
+  return SendCommand({"REPLCONF", "ACK", std::to_string(offset_)});
+}
+
+Status ReplicationSource::ReadCommands(const CommandCallback &cb) {
+  if (!snapshot_done_) {
+    return Status::InvalidArgument("the snapshot was not read");
+  }
+  std::vector<std::string> argv;
+  uint64_t ack_ns = static_cast<uint64_t>(options_.ack_interval_ms) * 1000000;
+  uint64_t timeout_ns = static_cast<uint64_t>(options_.timeout_ms) * 1000000;
+  int wait_ms = options_.timeout_ms;
+  if (offset_ >= 0 && options_.ack_interval_ms > 0) {
+    wait_ms = std::min(wait_ms, options_.ack_interval_ms);
+  }
+  uint64_t last_ack = NowNanos();
+  uint64_t last_data = last_ack;
+  Status s;
+  while (s.ok()) {
+    size_t used = 0;
+    int r = ParseCommand(rbuf_.data() + rpos_, rbuf_.size() - rpos_, &used, &argv);
+    if (r < 0) {
+      return Status::Corruption("bad command in replication stream");
+    }
+    if (r > 0) {
+      rpos_ += used;
+      if (offset_ >= 0) {
+        offset_ += used;
+      }
+      if (argv.empty()) {
+        continue;
+      }
+      if (offset_ >= 0 && argv.size() >= 2
+          && strcasecmp(argv[0].c_str(), "REPLCONF") == 0
+          && strcasecmp(argv[1].c_str(), "GETACK") == 0) {
+        s = SendAck();
+        last_ack = NowNanos();
+      }
+      if (s.ok()) {
+        s = cb(argv);
+      }
+      continue;
+    }
+    if (offset_ >= 0 && ack_ns > 0 && NowNanos() - last_ack >= ack_ns) {
+      s = SendAck();
+      last_ack = NowNanos();
+    }
+    if (s.ok()) {
+      s = Fill(wait_ms);
+      if (s.ok()) {
+        last_data = NowNanos();
+      } else if (s.IsTimeout() && NowNanos() - last_data < timeout_ns) {
+        s = Status::OK();
+      }
+    }
+  }
+  return s;
+}
+
+int ReplicationSource::Version() const {
+  return parser_->Version();
+}
+
+const std::vector<AuxKV> &ReplicationSource::AuxFields() {
+  return parser_->AuxFields();
+}
+
+}
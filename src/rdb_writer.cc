@@ -0,0 +1,193 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "include/rdb_writer.h"
+#include "rdbparse_impl.h"
+#include "util.h"
+
+namespace parser {
+
+RdbWriter::RdbWriter(const std::string &path, int fd, const RdbWriterOptions &options)
+  : path_(path), fd_(fd), buf_size_(options.block_size ? options.block_size : 4096),
+    buf_used_(0), offset_(0), check_sum_(0), version_(0), db_num_(-1) {
+  buf_ = new char[buf_size_];
+}
+
+RdbWriter::~RdbWriter() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  delete [] buf_;
+}
+
+Status RdbWriter::Open(const std::string &path, const RdbWriterOptions &options,
+    RdbWriter **writer) {
+  *writer = nullptr;
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return Status::IOError(path, strerror(errno));
+  }
+  *writer = new RdbWriter(path, fd, options);
+  return Status::OK();
+}
+
+Status RdbWriter::WriteFd(const char *data, size_t len) {
+  if (version_ >= 5) {
+    check_sum_ = crc64(check_sum_, reinterpret_cast<const unsigned char *>(data), len);
+  }
+  while (len > 0) {
+    ssize_t w = write(fd_, data, len);
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError(path_, strerror(errno));
+    }
+    data += w;
+    len -= w;
+  }
+  return Status::OK();
+}
+
+Status RdbWriter::Flush() {
+  Status s = WriteFd(buf_, buf_used_);
+  buf_used_ = 0;
+  return s;
+}
+
+Status RdbWriter::WriteRaw(const char *data, size_t len) {
+  offset_ += len;
+  if (len <= buf_size_ - buf_used_) {
+    memcpy(buf_ + buf_used_, data, len);
+    buf_used_ += len;
+    return Status::OK();
+  }
+  Status s = Flush();
+  if (!s.ok()) {
+    return s;
+  }
+  if (len >= buf_size_) {
+    return WriteFd(data, len);
+  }
+  memcpy(buf_, data, len);
+  buf_used_ = len;
+  return Status::OK();
+}
+
+Status RdbWriter::WriteLength(uint64_t len) {
+  char buf[9];
+  return WriteRaw(buf, EncodeLength(len, buf));
+}
+
+Status RdbWriter::WriteString(const Slice &str) {
+  Status s = WriteLength(str.size());
+  if (s.ok()) {
+    s = WriteRaw(str.data(), str.size());
+  }
+  return s;
+}
+
+Status RdbWriter::WriteHeader(int version) {
+  if (version <= 0 || version > 9999) {
+    return Status::InvalidArgument("unsupport rdb version");
+  }
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%s%04d", RdbParseImpl::kMagicString.c_str(), version);
+  version_ = version;
+  return WriteRaw(buf, 9);
+}
+
+Status RdbWriter::WriteAux(const Slice &key, const Slice &val) {
+  Status s = WriteByte(RdbParseImpl::kAux);
+  if (s.ok()) {
+    s = WriteString(key);
+  }
+  if (s.ok()) {
+    s = WriteString(val);
+  }
+  return s;
+}
+
+Status RdbWriter::WriteSelectDb(uint32_t db_num) {
+  Status s = WriteByte(RdbParseImpl::kSelectDb);
+  if (s.ok()) {
+    s = WriteLength(db_num);
+  }
+  db_num_ = db_num;
+  return s;
+}
+
+Status RdbWriter::WriteResizeDb(uint64_t db_size, uint64_t expire_size) {
+  Status s = WriteByte(RdbParseImpl::kResizedb);
+  if (s.ok()) {
+    s = WriteLength(db_size);
+  }
+  if (s.ok()) {
+    s = WriteLength(expire_size);
+  }
+  return s;
+}
+
+Status RdbWriter::WriteRawEntry(uint8_t rdb_type, const Slice &key,
+    const Slice &raw_value, int64_t expire_ms) {
+  Status s;
+  if (expire_ms >= 0) {
+    char buf[9];
+    buf[0] = static_cast<char>(RdbParseImpl::kExpireMs);
+    for (int i = 0; i < 8; i++) {
+      buf[1 + i] = static_cast<char>((static_cast<uint64_t>(expire_ms) >> (8 * i)) & 0xff);
+    }
+    s = WriteRaw(buf, sizeof(buf));
+  }
+  if (s.ok()) {
+    s = WriteByte(rdb_type);
+  }
+  if (s.ok()) {
+    s = WriteString(key);
+  }
+  if (s.ok()) {
+    s = WriteRaw(raw_value.data(), raw_value.size());
+  }
+  return s;
+}
+
+Status RdbWriter::WriteEntry(const ParsedResult &result) {
+  if (result.raw_value.empty()) {
+    return Status::InvalidArgument("no raw value captured", result.key);
+  }
+  if (db_num_ != static_cast<int64_t>(result.db_num)) {
+    Status s = WriteSelectDb(result.db_num);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return WriteRawEntry(result.rdb_type, result.key, result.raw_value, result.expire_time);
+}
+
+Status RdbWriter::Finish() {
+  Status s = WriteByte(RdbParseImpl::kEof);
+  if (s.ok()) {
+    s = Flush();
+  }
+  if (s.ok() && version_ >= 5) {
+    char buf[8];
+    uint64_t crc = check_sum_;
+    for (int i = 0; i < 8; i++) {
+      buf[i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+    }
+    offset_ += sizeof(buf);
+    s = WriteFd(buf, sizeof(buf));
+  }
+  if (s.ok() && fsync(fd_) != 0) {
+    s = Status::IOError(path_, strerror(errno));
+  }
+  if (close(fd_) != 0 && s.ok()) {
+    s = Status::IOError(path_, strerror(errno));
+  }
+  fd_ = -1;
+  return s;
+}
+
+}
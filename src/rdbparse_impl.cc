@@ -1,24 +1,32 @@
 #include <arpa/inet.h>
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <set>
 
 #include "rdbparse_impl.h"
 #include "include/rdbparse.h"
+#include "numeric.h"
 #include "util.h"
+#include "compressed_file.h"
 #include "intset.h"
+#include "listpack.h"
 #include "lzf.h"
+#include "trace_impl.h"
 #include "ziplist.h"
 #include "zipmap.h"
 
 namespace parser {
 
+const std::string RdbParseImpl::kMagicString = "REDIS";
+const uint64_t RdbParseImpl::kUncheckedStringBytes;
+
 void ParsedResult::Debug() {
   static std::set<std::string> type_set{"set", "string", "zset", "hash", "list"};
   if (!type_set.count(this->type)) {
     return;
   }
-  printf("db_num:%d, expire_time: %d, type: %s, key: %s,", this->db_num, this->expire_time, this->type.c_str(), this->key.c_str()); 
+  printf("db_num:%d, expire_time: %ld, type: %s, key: %s,", this->db_num, this->expire_time, this->type.c_str(), this->key.c_str()); 
   if (this->type == "string") {
     printf("value: %s\n", this->kv_value.c_str());
   } else if (this->type == "hash") {
@@ -53,6 +61,10 @@ void ParsedResult::Debug() {
           printf(", ");
         }
       }
+    } else if (!intset_value.empty()) {
+      for (size_t i = 0; i < intset_value.size(); i++) {
+        printf(i ? ", %ld" : "%ld", intset_value[i]);
+      }
     } else {
       auto& list_value = this->list_value; 
       for (auto it = list_value.begin(); it != list_value.end();) {
@@ -115,25 +127,65 @@ struct RdbParseImpl::Arena {
   char space[32];
 };
 
-RdbParseImpl::RdbParseImpl(const std::string &path):
-  path_(path), version_(kMagicString.size()), 
-  result_(new ParsedResult), valid_(true) {
+RdbParseImpl::RdbParseImpl(const std::string &path, const ParseOptions &options)
+  : RdbParseImpl(path, options, NULL) {
+  }
+
+RdbParseImpl::RdbParseImpl(const std::string &path, const ParseOptions &options,
+    ThreadPool *pool):
+  path_(path), options_(options), sequence_file_(NULL), window_(NULL), next_(NULL),
+  limit_(NULL), crc_from_(NULL), check_sum_(0), check_sum_partial_(false),
+  version_(kMagicString.size()), result_(new ParsedResult), capture_(NULL),
+  stats_(options.collect_stats ? new ParseStats : NULL), sample_mask_(0),
+  buffer_(NULL), resuming_(false), offset_(0), keys_(0), total_bytes_(0),
+  progress_on_(options.progress || !options.progress_textfile.empty()),
+  progress_checks_(0), progress_start_ns_(0), progress_next_offset_(0),
+  progress_next_ns_(0), callbacks_(0), callback_replay_(0),
+  chunk_on_(options.chunk_bytes > 0 && options.value_chunk && !options.capture_raw),
+  chunk_used_(0), chunks_(0),
+  decode_pool_(NULL), shared_pool_(pool), checkpoint_checks_(0), checkpoint_next_ns_(0), valid_(true) {
+    while (sample_mask_ + 1 < options.stats_sample_period) {
+      sample_mask_ = (sample_mask_ << 1) | 1;
+    }
+    if (options.decode_threads != 1) {
+      decode_pool_ = pool ? pool : new ThreadPool(options.decode_threads);
+    }
+  }
+
+RdbParseImpl::RdbParseImpl(BufferSequentialFile *buffer, const ParseOptions &options)
+  : RdbParseImpl(std::string(), options) {
+    sequence_file_ = buffer;
+    buffer_ = buffer;
   }
 
 RdbParseImpl::~RdbParseImpl() {
+  if (decode_pool_ != shared_pool_) {
+    delete decode_pool_;
+  }
   delete result_;
+  delete sequence_file_;
+  delete stats_;
 }
 
 Status RdbParseImpl::Init() {
-  Status s = NewSequentialFile(path_, &sequence_file_);  
-  if (!s.ok()) { return s; }
+  if (!sequence_file_) {
+    Status s = options_.follow
+      ? NewFollowSequentialFile(path_, options_.follow_timeout_ms, &sequence_file_)
+      : NewDetectedSequentialFile(path_, options_.decompress_threads,
+          shared_pool_, &sequence_file_);
+    if (!s.ok()) { return s; }
+  }
+  total_bytes_ = options_.follow ? 0 : sequence_file_->Size();
+  progress_start_ns_ = NowNanos();
 
   char buf[16];
   Slice result;
   if (!Read(9, &result, buf).ok() 
       || !result.starts_with(kMagicString)) {
-    return Status::Incomplete("unsupport rdb head magic");
+    return Status::Corruption("unsupport rdb head magic");
   }
+  // the header is in the checksum whatever the version
+  SyncChecksum();
   result.remove_prefix(kMagicString.size());  
   long version = 0; 
   if (!string2l(result.data(), result.size(), &version)) {
@@ -145,30 +197,133 @@ Status RdbParseImpl::Init() {
 ParsedResult* RdbParseImpl::Value() {
   return result_;
 }
-Status RdbParseImpl::Read(uint64_t len, Slice *result, char *scratch) {
-  Status s = sequence_file_->Read(len, result, scratch); 
+Status RdbParseImpl::ReadSlow(uint64_t len, Slice *result, char *scratch) {
+  ReleaseWindow();
+  Slice buffered = sequence_file_->Peek();
+  if (buffered.size() >= len) {
+    window_ = next_ = crc_from_ = buffered.data();
+    limit_ = window_ + buffered.size();
+    return Read(len, result, scratch);
+  }
+  // not buffered, or only part of it
+  Status s;
+  {
+    StatsTimer timer(stats_, kTimerIo, sample_mask_);
+    TRACE_SPAN_MIN("io", 1000);
+    s = sequence_file_->Read(len, result, scratch); 
+  }
   if (!s.ok()) {
     return s;
   }
+  offset_ += len;
+  if (stats_) {
+    stats_->bytes_read += len;
+    stats_->read_calls++;
+  }
   if (version_ >= 5) {
+    StatsTimer timer(stats_, kTimerCrc, sample_mask_);
     uint8_t *p1 = reinterpret_cast<uint8_t *>(scratch); 
     check_sum_ = crc64(check_sum_, p1, len); 
+    if (stats_) {
+      stats_->checksum_bytes += len;
+    }
+  }
+  if (capture_) {
+    capture_->append(scratch, len);
   }
   return s;
 }
-Status RdbParseImpl::LoadExpiretime(uint8_t type, int *expire_time) {
+void RdbParseImpl::SyncChecksum() {
+  size_t n = next_ - crc_from_;
+  if (n > 0 && version_ >= 5) {
+    StatsTimer timer(stats_, kTimerCrc, sample_mask_);
+    check_sum_ = crc64(check_sum_, reinterpret_cast<const uint8_t *>(crc_from_), n);
+    if (stats_) {
+      stats_->checksum_bytes += n;
+    }
+  }
+  crc_from_ = next_;
+}
+void RdbParseImpl::ReleaseWindow() {
+  if (window_ == NULL) {
+    return;
+  }
+  SyncChecksum();
+  sequence_file_->Advance(next_ - window_);
+  window_ = next_ = limit_ = crc_from_ = NULL;
+}
+Status RdbParseImpl::Skip(uint64_t len) {
+  if (total_bytes_ && len > total_bytes_ - std::min(offset_, total_bytes_)) {
+    return Status::Corruption("skip past the end of the file");
+  }
+  offset_ += len;
+  if (stats_) {
+    stats_->skipped_bytes += len;
+  }
+  if (len <= static_cast<uint64_t>(limit_ - next_)) {
+    if (capture_) {
+      capture_->append(next_, len);
+    } else if (!options_.follow) {
+      // skipped bytes are left out of the checksum, as below
+      SyncChecksum();
+      crc_from_ = next_ + len;
+      check_sum_partial_ = check_sum_partial_ || len > 0;
+    }
+    next_ += len;
+    return Status::OK();
+  }
+  ReleaseWindow();
+  StatsTimer timer(stats_, kTimerIo, sample_mask_);
+  TRACE_SPAN_MIN("io", 1000);
+  if (!capture_ && !options_.follow) {
+    check_sum_partial_ = check_sum_partial_ || len > 0;
+    return sequence_file_->Skip(len);
+  }
+  // the checksum verified in follow mode needs the skipped bytes too
+  char buf[16 * 1024];
+  Status s;
+  while (s.ok() && len > 0) {
+    char *scratch = buf;
+    size_t n = len;
+    if (capture_) {
+      // see ReadString
+      if (!total_bytes_) {
+        n = std::min<uint64_t>(len, kUncheckedStringBytes);
+      }
+      size_t offset = capture_->size();
+      capture_->resize(offset + n);
+      scratch = &(*capture_)[offset];
+    } else if (n > sizeof(buf)) {
+      n = sizeof(buf);
+    }
+    s = sequence_file_->Read(n, nullptr, scratch);
+    if (s.ok() && version_ >= 5) {
+      check_sum_ = crc64(check_sum_, reinterpret_cast<uint8_t *>(scratch), n);
+      if (stats_) {
+        stats_->checksum_bytes += n;
+      }
+    }
+    len -= n;
+  }
+  return s;
+}
+Status RdbParseImpl::LoadExpiretime(uint8_t type, int64_t *expire_ms) {
   char buf[8];
   Status s;
   if (type == kExpireMs) {
     uint64_t t64;  
     s = Read(8, nullptr, buf); 
     memcpy(&t64, buf, 8);
-    *expire_time = static_cast<int>(t64/1000); 
+    // -1 means no ttl, a corrupt all-ones value must not pass for it
+    if (s.ok() && t64 > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+      return Status::Corruption("bad expire time");
+    }
+    *expire_ms = static_cast<int64_t>(t64);
   } else {
     uint32_t t32;
     s = Read(4, nullptr, buf); 
     memcpy(&t32, buf, 4);
-    *expire_time = static_cast<int>(t32);
+    *expire_ms = static_cast<int64_t>(t32) * 1000;
   }
   return s; 
 }
@@ -184,7 +339,7 @@ Status RdbParseImpl::LoadEntryKey(std::string *result) {
 }
 
 Status RdbParseImpl::LoadIntVal(uint32_t type, std::string *result) {
-  char buf[8];
+  char buf[20];
   Status s;
   int32_t val;
   if (type == kEncInt8) {
@@ -199,7 +354,7 @@ Status RdbParseImpl::LoadIntVal(uint32_t type, std::string *result) {
     uint16_t t = static_cast<uint8_t>(buf[0]) | (static_cast<uint8_t>(buf[1]) << 8);
     val = static_cast<int16_t>(t);
   } else if (type == kEncInt32) {
-    if (Read(4, nullptr, buf).ok()) {
+    if (!Read(4, nullptr, buf).ok()) {
       return Status::Corruption("parse int val err");
     }
     val = static_cast<uint8_t>(buf[0]) | (static_cast<uint8_t>(buf[1]) << 8) 
@@ -207,7 +362,7 @@ Status RdbParseImpl::LoadIntVal(uint32_t type, std::string *result) {
   } else {
     return Status::Corruption("no supported type");
   }
-  result->assign(std::to_string(val));
+  result->assign(buf, FormatInt64(val, buf));
   return s; 
 }
 
@@ -219,21 +374,49 @@ Status RdbParseImpl::LoadEncLzf(std::string *result) {
   if (!LoadLength(&raw_len, NULL).ok()) {
     return Status::Corruption("parse enclzf raw_len error");          
   }
-
-  char *compress_buf = new char[compress_len];
-  char *raw_buf = new char[raw_len]; 
-  if (!compress_buf || !raw_buf) { 
-    return Status::Corruption("no enough memory to alloc"); 
+  if (raw_len == 0 || raw_len / kLzfMaxRatio > compress_len) {
+    return Status::Corruption("parse enclzf raw_len error");
   }
-  bool ret = Read(compress_len, nullptr, compress_buf).ok() 
-    && (0 != DecompressLzf(compress_buf, compress_len, raw_buf, raw_len));
+
+  bool ret = ReadString(compress_len, &lzf_in_).ok();
   if (ret) {
-    result->assign(raw_buf, raw_len);
+    StatsTimer timer(stats_, kTimerLzf, sample_mask_);
+    TRACE_SPAN("lzf");
+    result->resize(raw_len);
+    ret = raw_len == DecompressLzf(lzf_in_.data(), compress_len, &(*result)[0], raw_len);
+  }
+  if (stats_) {
+    stats_->allocations++;
+    stats_->lzf_bytes_in += compress_len;
+    stats_->lzf_bytes_out += raw_len;
   }
-  delete [] compress_buf;
-  delete [] raw_buf;
   return ret ? Status::OK() : Status::Corruption("parse enclzf error"); 
 }
+
+// Lengths read from the file are trusted only as far as bytes remain, so a
+// corrupt one fails instead of being allocated. When the size is unknown
+// (push mode, compressed or followed files) big strings grow as their
+// bytes arrive.
+Status RdbParseImpl::ReadString(uint64_t len, std::string *result) {
+  if (total_bytes_ && len > total_bytes_ - std::min(offset_, total_bytes_)) {
+    return Status::Corruption("string longer than the rest of the file");
+  }
+  const char *p = ReadInPlace(len);
+  if (p != NULL) {
+    result->assign(p, len);
+    return Status::OK();
+  }
+  uint64_t n = total_bytes_ ? len : std::min<uint64_t>(len, kUncheckedStringBytes);
+  result->resize(n);
+  Status s = Read(n, nullptr, &(*result)[0]);
+  while (s.ok() && n < len) {
+    uint64_t step = std::min(len - n, n);
+    result->resize(n + step);
+    s = Read(step, nullptr, &(*result)[n]);
+    n += step;
+  }
+  return s;
+}
 void RdbParseImpl::ResetResult() {
   result_->expire_time = -1;
   result_->type.clear();
@@ -242,87 +425,364 @@ void RdbParseImpl::ResetResult() {
   result_->set_value.clear();
   result_->map_value.clear();
   result_->list_value.clear();
-
+  result_->zset_value.clear();
+  result_->intset_value.clear();
+  result_->raw_value.clear();
+  result_->stream_value = StreamInfo();
+  result_->chunk = kWholeValue;
+  callbacks_ = 0;
+  chunk_used_ = 0;
+  chunks_ = 0;
 }
 Status RdbParseImpl::LoadListZiplist(std::list<std::string> *value) {
   std::string buf;
-  if (!LoadString(&buf).ok()) {
+  Status s = LoadString(&buf);
+  if (!s.ok()) {
     return Status::Corruption("parse list ziplist err");
   }
-  ZiplistParser ziplist_parser((void *)(buf.c_str()));  
-  return ziplist_parser.GetList(value);
+  StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+  TRACE_SPAN("ziplist");
+  size_t before = value->size();
+  ZiplistParser ziplist_parser((void *)(buf.c_str()), buf.size());
+  s = ziplist_parser.GetList(value);
+  if (stats_) {
+    stats_->allocations += value->size() - before;
+  }
+  return s;
 }
 Status RdbParseImpl::LoadZsetOrHashZiplist(std::map<std::string, std::string> *result) {
   std::string buf;
   Status s = LoadString(&buf);
   if (!s.ok()) { return s; }
-  ZiplistParser ziplist_parser((void *)buf.c_str());
-  return ziplist_parser.GetZsetOrHash(result);
+  StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+  TRACE_SPAN("ziplist");
+  ZiplistParser ziplist_parser((void *)buf.c_str(), buf.size());
+  s = ziplist_parser.GetZsetOrHash(result);
+  if (stats_) {
+    stats_->allocations += result->size();
+  }
+  return s;
 }
 Status RdbParseImpl::LoadZipmap(std::map<std::string, std::string> *result) {
   std::string buf;
   Status s = LoadString(&buf);
   if (!s.ok()) { return s; }
-  ZipmapParser zipmap_parser((void *)(buf.c_str()));
-  return zipmap_parser.GetMap(result);
+  StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+  TRACE_SPAN("zipmap");
+  ZipmapParser zipmap_parser((void *)(buf.c_str()), buf.size());
+  s = zipmap_parser.GetMap(result);
+  if (stats_) {
+    stats_->allocations += result->size();
+  }
+  return s;
 }
 Status RdbParseImpl::LoadListOrSet(std::list<std::string> *result) {
-  uint32_t i; 
+  uint64_t i, first; 
   uint64_t field_size;   
-  Status s = LoadLength(&field_size, NULL);  
+  Status s = LoadElements(&field_size, &first);  
   if (!s.ok()) { return s; }
   std::string val;
-  for (i = 0; i < field_size; i++) {
+  for (i = first; i < field_size; i++) {
+    ElementBoundary(i, field_size);
     if (!LoadString(&val).ok()) {
       break;
     } 
+    if (ChunkFull() && !FlushChunk().ok()) {
+      break;
+    }
+    StatsTimer timer(stats_, kTimerBuild, sample_mask_);
     result->push_back(val);
+    ChunkAdd(val.size() + kChunkNodeBytes);
+  }
+  if (stats_) {
+    stats_->allocations += i;
   }
   return i == field_size ? Status::OK() : Status::Corruption("Parse error");
 } 
 Status RdbParseImpl::LoadHash(std::map<std::string, std::string> *result) {
-  uint32_t i;
+  uint64_t i, first;
   uint64_t field_size;   
-  Status s = LoadLength(&field_size, NULL);  
+  Status s = LoadElements(&field_size, &first);  
   if (!s.ok()) { return s; }
   std::string key, value;
-  for (i = 0; i < field_size; i++) {
+  for (i = first; i < field_size; i++) {
+    ElementBoundary(i, field_size);
     if (!LoadString(&key).ok() || !LoadString(&value).ok()) {
       break;
     }
+    if (ChunkFull() && !FlushChunk().ok()) {
+      break;
+    }
+    StatsTimer timer(stats_, kTimerBuild, sample_mask_);
     result->insert({key, value});
+    ChunkAdd(key.size() + value.size() + kChunkNodeBytes);
+  }
+  if (stats_) {
+    stats_->allocations += i;
   }
   return i == field_size ? Status::OK() : Status::Corruption("Parse error");
 }
 Status RdbParseImpl::LoadZset(std::map<std::string, double> *result, bool zset2) {
-  uint32_t i; 
+  uint64_t i, first; 
   uint64_t field_size;   
-  Status s = LoadLength(&field_size, NULL);  
+  Status s = LoadElements(&field_size, &first);  
   if (!s.ok()) { return s; }
   std::string key;
   double val;
-  for (i = 0; i < field_size; i++) {
+  for (i = first; i < field_size; i++) {
+    ElementBoundary(i, field_size);
     if (!LoadString(&key).ok()) {
       break;
     }
     s = zset2 ? LoadBinaryDouble(&val) : LoadDouble(&val);
     if (!s.ok()) { break; }
+    if (ChunkFull() && !FlushChunk().ok()) {
+      break;
+    }
 
+    StatsTimer timer(stats_, kTimerBuild, sample_mask_);
     result->insert({key, val});
+    ChunkAdd(key.size() + sizeof(val) + kChunkNodeBytes);
   }
   return i == field_size ? Status::OK() : Status::Corruption("Parse error");
 }  
 Status RdbParseImpl::LoadListQuicklist(std::list<std::string> *result) {
-  uint32_t i; 
+  uint64_t i, first; 
   uint64_t field_size; 
-  Status s = LoadLength(&field_size, NULL);
+  Status s = LoadElements(&field_size, &first);
   if (!s.ok()) { return s; }
-  for (i = 0; i < field_size; i++) {
+  // push mode resumes node by node
+  if (decode_pool_ && !buffer_ && !chunk_on_ && field_size >= options_.parallel_decode_nodes) {
+    return LoadQuicklistParallel(field_size, false, result);
+  }
+  for (i = first; i < field_size; i++) {
+    TRACE_SPAN("quicklist_node");
+    if (ChunkFull() && !FlushChunk().ok()) {
+      break;
+    }
+    ElementBoundary(i, field_size);
+    size_t before = result->size();
     s = LoadListZiplist(result); 
     if (!s.ok()) { break; }
+    AddListChunkBytes(*result, result->size() - before);
   }
   return i == field_size ? Status::OK() : Status::Corruption("parse Corruption");
 }
+Status RdbParseImpl::LoadZsetOrHashListpack(std::map<std::string, std::string> *result) {
+  Slice listpack;
+  Status s = LoadStringInPlace(&listpack, &listpack_buf_);
+  if (!s.ok()) { return s; }
+  StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+  TRACE_SPAN("listpack");
+  ListpackParser listpack_parser(listpack.data(), listpack.size());
+  s = listpack_parser.GetZsetOrHash(result);
+  if (stats_) {
+    stats_->allocations += result->size();
+  }
+  return s;
+}
+Status RdbParseImpl::LoadSetListpack(std::set<std::string> *result) {
+  Slice listpack;
+  Status s = LoadStringInPlace(&listpack, &listpack_buf_);
+  if (!s.ok()) { return s; }
+  StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+  TRACE_SPAN("listpack");
+  ListpackParser listpack_parser(listpack.data(), listpack.size());
+  s = listpack_parser.GetSet(result);
+  if (stats_) {
+    stats_->allocations += result->size();
+  }
+  return s;
+}
+// Every node is a listpack, or a single large element stored as is.
+Status RdbParseImpl::LoadListQuicklist2(std::list<std::string> *result) {
+  uint64_t i, first, nodes, container;
+  Status s = LoadElements(&nodes, &first);
+  if (!s.ok()) { return s; }
+  // push mode resumes node by node
+  if (decode_pool_ && !buffer_ && !chunk_on_ && nodes >= options_.parallel_decode_nodes) {
+    return LoadQuicklistParallel(nodes, true, result);
+  }
+  Slice node;
+  for (i = first; i < nodes; i++) {
+    TRACE_SPAN("quicklist_node");
+    if (ChunkFull() && !FlushChunk().ok()) {
+      break;
+    }
+    ElementBoundary(i, nodes);
+    s = LoadLength(&container, NULL);
+    if (s.ok()) {
+      s = LoadStringInPlace(&node, &listpack_buf_);
+    }
+    if (!s.ok()) { break; }
+    if (container == kQuicklistNodePlain) {
+      result->push_back(node.ToString());
+      ChunkAdd(node.size() + kChunkNodeBytes);
+      continue;
+    }
+    if (container != kQuicklistNodePacked) {
+      s = Status::Corruption("unknown quicklist container");
+      break;
+    }
+    StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+    size_t before = result->size();
+    ListpackParser listpack_parser(node.data(), node.size());
+    s = listpack_parser.GetList(result);
+    if (stats_) {
+      stats_->allocations += result->size() - before;
+    }
+    if (!s.ok()) { break; }
+    AddListChunkBytes(*result, result->size() - before);
+  }
+  return i == nodes ? Status::OK() : Status::Corruption("parse Corruption");
+}
+// A quicklist node as read from the file, decoded on the decode pool.
+struct RdbParseImpl::QuicklistNode {
+  QuicklistNode() : container(kQuicklistNodePacked), lzf(false), raw_len(0) {}
+  uint64_t container;
+  std::string data;
+  // data still LZF compressed, to raw_len bytes
+  bool lzf;
+  uint64_t raw_len;
+};
+
+Status RdbParseImpl::DecodeQuicklistNodes(QuicklistNode *nodes, size_t n,
+    bool quicklist2, std::list<std::string> *out) {
+  TRACE_SPAN("quicklist_nodes");
+  std::string raw;
+  for (size_t i = 0; i < n; i++) {
+    QuicklistNode &node = nodes[i];
+    const std::string *buf = &node.data;
+    if (node.lzf) {
+      raw.resize(node.raw_len);
+      if (node.raw_len == 0 || DecompressLzf(node.data.data(), node.data.size(),
+            &raw[0], node.raw_len) != node.raw_len) {
+        return Status::Corruption("parse enclzf error");
+      }
+      buf = &raw;
+    }
+    Status s;
+    if (!quicklist2) {
+      ZiplistParser ziplist_parser((void *)(buf->c_str()), buf->size());
+      s = ziplist_parser.GetList(out);
+    } else if (node.container == kQuicklistNodePlain) {
+      out->push_back(*buf);
+    } else if (node.container == kQuicklistNodePacked) {
+      ListpackParser listpack_parser(buf->data(), buf->size());
+      s = listpack_parser.GetList(out);
+    } else {
+      s = Status::Corruption("unknown quicklist container");
+    }
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+// LoadString that leaves LZF data compressed.
+Status RdbParseImpl::ReadQuicklistNode(QuicklistNode *node) {
+  uint64_t len;
+  bool is_encoded = false;
+  Status s = LoadLength(&len, &is_encoded);
+  if (!s.ok()) { return s; }
+  if (stats_) {
+    CountStringEncoding(is_encoded, len);
+  }
+  node->lzf = is_encoded && len == kEncLzf;
+  if (node->lzf) {
+    if (!LoadLength(&len, NULL).ok() || !LoadLength(&node->raw_len, NULL).ok()) {
+      return Status::Corruption("parse enclzf length error");
+    }
+    if (stats_) {
+      stats_->allocations += 2;
+      stats_->lzf_bytes_in += len;
+      stats_->lzf_bytes_out += node->raw_len;
+    }
+  } else if (is_encoded) {
+    return len < kEncLzf ? LoadIntVal(len, &node->data) : Status::Corruption("");
+  }
+  if (node->lzf && (node->raw_len == 0 || node->raw_len / kLzfMaxRatio > len)) {
+    return Status::Corruption("parse enclzf raw_len error");
+  }
+  return ReadString(len, &node->data);
+}
+
+// Nodes are read a batch at a time while the pool decodes the batch read
+// before, each task a run of consecutive nodes into its own list, and the
+// lists are spliced in order.
+Status RdbParseImpl::LoadQuicklistParallel(uint64_t nodes, bool quicklist2,
+    std::list<std::string> *result) {
+  static const size_t kNodesPerTask = 8;
+  const size_t batch_size = kNodesPerTask * decode_pool_->size() * 2;
+  std::vector<QuicklistNode> batch[2];
+  std::vector<std::list<std::string>> out[2];
+  std::vector<std::future<Status>> pending;
+  int cur = 0;
+  uint64_t read = 0;
+  Status s;
+  while (true) {
+    std::vector<QuicklistNode> &b = batch[cur];
+    b.resize(std::min<uint64_t>(batch_size, nodes - read));
+    for (size_t i = 0; s.ok() && i < b.size(); i++) {
+      TRACE_SPAN("quicklist_node");
+      if (quicklist2) {
+        s = LoadLength(&b[i].container, NULL);
+      }
+      if (s.ok()) {
+        s = ReadQuicklistNode(&b[i]);
+      }
+    }
+    read += b.size();
+    // the tasks of the other batch are done before it is reused
+    for (std::future<Status> &f : pending) {
+      Status t = f.get();
+      if (s.ok()) {
+        s = t;
+      }
+    }
+    pending.clear();
+    size_t before = result->size();
+    for (std::list<std::string> &l : out[cur ^ 1]) {
+      result->splice(result->end(), l);
+    }
+    if (stats_) {
+      stats_->allocations += result->size() - before;
+    }
+    if (!s.ok() || b.empty()) {
+      break;
+    }
+    out[cur].resize((b.size() + kNodesPerTask - 1) / kNodesPerTask);
+    for (size_t t = 0; t < out[cur].size(); t++) {
+      QuicklistNode *first = &b[t * kNodesPerTask];
+      size_t n = std::min(kNodesPerTask, b.size() - t * kNodesPerTask);
+      std::list<std::string> *l = &out[cur][t];
+      pending.push_back(decode_pool_->Submit([first, n, quicklist2, l]() {
+        return DecodeQuicklistNodes(first, n, quicklist2, l);
+      }));
+    }
+    cur ^= 1;
+  }
+  return s.ok() ? Status::OK() : Status::Corruption("parse Corruption");
+}
+
+Status RdbParseImpl::SkipQuicklist2() {
+  uint64_t nodes, first, container;
+  if (!LoadElements(&nodes, &first).ok()) {
+    return Status::Corruption("skip quicklist error");
+  }
+  for (uint64_t i = first; i < nodes; i++) {
+    ElementBoundary(i, nodes);
+    Status s = LoadLength(&container, NULL);
+    if (s.ok()) {
+      s = SkipString();
+    }
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
 
 Status RdbParseImpl::SkipModule() {
   uint64_t id;
@@ -357,7 +817,9 @@ Status RdbParseImpl::SkipModule() {
   }
   return Status::OK();
 }
-Status RdbParseImpl::SkipStream() {
+// Stream listpacks 2 (Redis 7.0) add the first, max deleted and entries
+// added ids and a per group entries_read, 3 (7.2) a consumer active time.
+Status RdbParseImpl::SkipStream(uint8_t type) {
   uint64_t len; 
   const std::string err_msg = "skip stream error";
   if (!LoadLength(&len, NULL).ok()) {
@@ -368,7 +830,9 @@ Status RdbParseImpl::SkipStream() {
       return Status::Corruption(err_msg);
     }
   }
-  for (uint64_t i = 0; i < 4; i++) {
+  // length, last id and the group count, plus five more from version 2
+  uint64_t fields = type == kRdbStreamListpacks ? 4 : 9;
+  for (uint64_t i = 0; i < fields; i++) {
     if (!LoadLength(&len, NULL).ok()) {
       return Status::Corruption(err_msg);
     }
@@ -381,14 +845,14 @@ Status RdbParseImpl::SkipStream() {
      } 
 
      // skip, donnot care value
-     for (uint64_t i = 0; i < 3; i++) {
+     for (uint64_t i = 0; i < (type == kRdbStreamListpacks ? 3 : 4); i++) {
        if (!(LoadLength(&pends, NULL).ok())) {
          return Status::Corruption(err_msg);
        }
      }
      for (uint64_t j = 0; j < pends; j++) {
        uint64_t length;
-       if (!sequence_file_->Skip(16 + 8).ok()
+       if (!Skip(16 + 8).ok()
            || !LoadLength(&length, NULL).ok()) {
           return Status::Corruption(err_msg);
        }
@@ -396,12 +860,13 @@ Status RdbParseImpl::SkipStream() {
      if (!LoadLength(&consumers, NULL).ok()) {
         return Status::Corruption(err_msg); 
      }
+     uint64_t times = type == kRdbStreamListpacks3 ? 16 : 8;
      for (uint64_t j = 0; j < consumers; j++) {
        uint64_t skip_blocks; 
        if (!SkipString().ok() 
-           || !sequence_file_->Skip(8).ok()
+           || !Skip(times).ok()
            || !LoadLength(&skip_blocks, NULL).ok()
-           || !sequence_file_->Skip(skip_blocks * 16).ok()) {
+           || !Skip(skip_blocks * 16).ok()) {
           return Status::Corruption(err_msg);
        }
      }
@@ -409,11 +874,196 @@ Status RdbParseImpl::SkipStream() {
   return Status::OK();
 
 } 
+Status RdbParseImpl::LoadStream(uint8_t type, StreamInfo *info) {
+  TRACE_SPAN("stream");
+  const std::string err_msg = "parse stream error";
+  uint64_t nodes;
+  if (!LoadLength(&nodes, NULL).ok()) {
+    return Status::Corruption(err_msg);
+  }
+  std::string node_key;
+  for (uint64_t i = 0; i < nodes; i++) {
+    // the node key is the big endian master entry id
+    if (!LoadString(&node_key).ok() || node_key.size() != 16) {
+      return Status::Corruption(err_msg);
+    }
+    Status s;
+    if (options_.stream_entry) {
+      StreamId master(DecodeBigEndian64(node_key.data()),
+          DecodeBigEndian64(node_key.data() + 8));
+      Slice listpack;
+      s = LoadStringInPlace(&listpack, &listpack_buf_);
+      if (s.ok()) {
+        s = LoadStreamListpack(listpack, master);
+      }
+    } else {
+      s = SkipString();
+    }
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  info->listpacks = nodes;
+
+  bool v2 = type != kRdbStreamListpacks;
+  uint64_t entries_read;
+  if (!LoadLength(&info->length, NULL).ok()
+      || !LoadLength(&info->last_id.ms, NULL).ok()
+      || !LoadLength(&info->last_id.seq, NULL).ok()
+      || (v2 && (!LoadLength(&info->first_id.ms, NULL).ok()
+          || !LoadLength(&info->first_id.seq, NULL).ok()
+          || !LoadLength(&info->max_deleted_id.ms, NULL).ok()
+          || !LoadLength(&info->max_deleted_id.seq, NULL).ok()
+          || !LoadLength(&info->entries_added, NULL).ok()))) {
+    return Status::Corruption(err_msg);
+  }
+  uint64_t groups, pending, consumers;
+  if (!LoadLength(&groups, NULL).ok()) {
+    return Status::Corruption(err_msg);
+  }
+  // counts come from the file, vectors grow as their elements are read
+  for (uint64_t i = 0; i < groups; i++) {
+    info->groups.emplace_back();
+    StreamGroup &g = info->groups.back();
+    if (!LoadString(&g.name).ok()
+        || !LoadLength(&g.last_id.ms, NULL).ok()
+        || !LoadLength(&g.last_id.seq, NULL).ok()
+        || (v2 && !LoadLength(&entries_read, NULL).ok())
+        || !LoadLength(&pending, NULL).ok()) {
+      return Status::Corruption(err_msg);
+    }
+    // saved as a length, -1 comes back as 2^64 - 1
+    g.entries_read = v2 ? static_cast<int64_t>(entries_read) : -1;
+    for (uint64_t j = 0; j < pending; j++) {
+      g.pending.emplace_back();
+      StreamPendingEntry &pe = g.pending.back();
+      if (!LoadStreamId(&pe.id).ok()
+          || !LoadMillisecondTime(&pe.delivery_time_ms).ok()
+          || !LoadLength(&pe.delivery_count, NULL).ok()) {
+        return Status::Corruption(err_msg);
+      }
+    }
+    if (!LoadLength(&consumers, NULL).ok()) {
+      return Status::Corruption(err_msg);
+    }
+    for (uint64_t j = 0; j < consumers; j++) {
+      g.consumers.emplace_back();
+      StreamConsumer &c = g.consumers.back();
+      if (!LoadString(&c.name).ok()
+          || !LoadMillisecondTime(&c.seen_time_ms).ok()
+          || (type == kRdbStreamListpacks3 && !LoadMillisecondTime(&c.active_time_ms).ok())
+          || !LoadLength(&pending, NULL).ok()) {
+        return Status::Corruption(err_msg);
+      }
+      for (uint64_t k = 0; k < pending; k++) {
+        c.pending.emplace_back();
+        if (!LoadStreamId(&c.pending.back()).ok()) {
+          return Status::Corruption(err_msg);
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
+// A listpack starts with the master entry: count, deleted, the number of
+// master fields, the fields and a 0. Every entry then holds its flags, its
+// id as a delta to the master id, either the values of the master fields or
+// its own field count and pairs, and its element count.
+Status RdbParseImpl::LoadStreamListpack(const Slice &listpack, const StreamId &master) {
+  StatsTimer timer(stats_, kTimerZiplist, sample_mask_);
+  const size_t kInt = ListpackParser::kMaxIntChars;
+  ListpackParser lp(listpack.data(), listpack.size());
+  int64_t count, deleted, num_master, zero;
+  // every listpack element takes 2 bytes or more
+  if (!lp.NextInt(&count) || !lp.NextInt(&deleted) || !lp.NextInt(&num_master)
+      || num_master < 0 || static_cast<uint64_t>(num_master) > listpack.size() / 2) {
+    return Status::Corruption("parse stream master entry error");
+  }
+  master_fields_.resize(num_master);
+  master_ints_.resize(num_master * kInt);
+  for (int64_t i = 0; i < num_master; i++) {
+    if (!lp.Next(&master_fields_[i], &master_ints_[i * kInt])) {
+      return Status::Corruption("parse stream master entry error");
+    }
+  }
+  if (!lp.NextInt(&zero)) {
+    return Status::Corruption("parse stream master entry error");
+  }
+
+  int64_t flags, ms, seq, num_fields, lp_count;
+  while (lp.NextInt(&flags)) {
+    if (!lp.NextInt(&ms) || !lp.NextInt(&seq)) {
+      return Status::Corruption("parse stream entry error");
+    }
+    bool same = flags & kStreamItemSameFields;
+    num_fields = num_master;
+    if (!same && (!lp.NextInt(&num_fields) || num_fields < 0
+          || static_cast<uint64_t>(num_fields) > listpack.size() / 4)) {
+      return Status::Corruption("parse stream entry error");
+    }
+    stream_entry_.fields.resize(num_fields);
+    entry_ints_.resize(2 * num_fields * kInt);
+    for (int64_t i = 0; i < num_fields; i++) {
+      std::pair<Slice, Slice> &f = stream_entry_.fields[i];
+      if (same) {
+        f.first = master_fields_[i];
+      } else if (!lp.Next(&f.first, &entry_ints_[2 * i * kInt])) {
+        return Status::Corruption("parse stream entry error");
+      }
+      if (!lp.Next(&f.second, &entry_ints_[(2 * i + 1) * kInt])) {
+        return Status::Corruption("parse stream entry error");
+      }
+    }
+    if (!lp.NextInt(&lp_count)) {
+      return Status::Corruption("parse stream entry error");
+    }
+    if (flags & kStreamItemDeleted) {
+      continue;
+    }
+    stream_entry_.id = StreamId(master.ms + ms, master.seq + seq);
+    // a push mode retry already passed the first callback_replay_ entries
+    if (callbacks_++ < callback_replay_) {
+      continue;
+    }
+    Status s = options_.stream_entry(result_->key, stream_entry_);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return lp.status();
+}
+
+Status RdbParseImpl::LoadStreamId(StreamId *id) {
+  char buf[16];
+  Status s = Read(16, nullptr, buf);
+  if (s.ok()) {
+    id->ms = DecodeBigEndian64(buf);
+    id->seq = DecodeBigEndian64(buf + 8);
+  }
+  return s;
+}
+
+Status RdbParseImpl::LoadMillisecondTime(int64_t *ms) {
+  char buf[8];
+  Status s = Read(8, nullptr, buf);
+  if (s.ok()) {
+    memcpy(ms, buf, 8);
+    if (!kLittleEndian) {
+      std::reverse(reinterpret_cast<char *>(ms), reinterpret_cast<char *>(ms) + 8);
+    }
+  }
+  return s;
+}
+
 Status RdbParseImpl::LoadString(std::string *result) {
   uint64_t len;
   bool is_encoded = false;
   Status s = LoadLength(&len, &is_encoded);
   if (!s.ok()) { return s; } 
+  if (stats_) {
+    CountStringEncoding(is_encoded, len);
+  }
   if (is_encoded) {
     switch (len) {
       case kEncInt8: 
@@ -426,34 +1076,227 @@ Status RdbParseImpl::LoadString(std::string *result) {
         return Status::Corruption("");
     }  
   }
-  char *buf = new char[len];
-  s = Read(len, nullptr, buf);  
-  if (s.ok()) result->assign(buf, len);
-  delete [] buf;
+  // read straight into the result, no bounce buffer
+  if (stats_) {
+    stats_->allocations++;
+  }
+  return ReadString(len, result);
+}
+
+Status RdbParseImpl::LoadStringInPlace(Slice *result, std::string *scratch) {
+  uint64_t len;
+  bool is_encoded = false;
+  Status s = LoadLength(&len, &is_encoded);
+  if (!s.ok()) { return s; }
+  if (!is_encoded) {
+    const char *p = ReadInPlace(len);
+    if (p != NULL) {
+      if (stats_) {
+        CountStringEncoding(false, len);
+      }
+      *result = Slice(p, len);
+      return Status::OK();
+    }
+  }
+  if (stats_) {
+    CountStringEncoding(is_encoded, len);
+  }
+  if (!is_encoded) {
+    if (stats_) {
+      stats_->allocations++;
+    }
+    s = ReadString(len, scratch);
+  } else if (len == kEncLzf) {
+    s = LoadEncLzf(scratch);
+  } else if (len <= kEncInt32) {
+    s = LoadIntVal(len, scratch);
+  } else {
+    s = Status::Corruption("");
+  }
+  if (s.ok()) {
+    *result = Slice(*scratch);
+  }
+  return s;
+}
+
+void RdbParseImpl::CountStringEncoding(bool is_encoded, uint64_t len) {
+  int encoding = kStringRaw;
+  if (is_encoded && len <= kEncLzf) {
+    encoding = kStringInt8 + len;
+  }
+  stats_->strings_per_encoding[encoding]++;
+}
+
+// LoadString for string values, read in chunk_bytes slices in chunked mode.
+Status RdbParseImpl::LoadStringValue(std::string *result) {
+  if (!chunk_on_) {
+    return LoadString(result);
+  }
+  uint64_t len;
+  bool is_encoded = false;
+  Status s = LoadLength(&len, &is_encoded);
+  if (!s.ok()) { return s; }
+  if (stats_) {
+    CountStringEncoding(is_encoded, len);
+  }
+  if (is_encoded) {
+    if (len == kEncLzf) {
+      return LoadEncLzfChunked(result);
+    }
+    return len < kEncLzf ? LoadIntVal(len, result) : Status::Corruption("");
+  }
+  while (s.ok() && len > options_.chunk_bytes) {
+    result->resize(options_.chunk_bytes);
+    s = Read(options_.chunk_bytes, nullptr, &(*result)[0]);
+    len -= options_.chunk_bytes;
+    if (s.ok()) {
+      s = FlushChunk();
+    }
+  }
+  if (!s.ok()) { return s; }
+  return ReadString(len, result);
+}
+
+// LZF back references reach at most 8KB back, so the compressed bytes are
+// read in slices and only that much output is kept past each chunk.
+Status RdbParseImpl::LoadEncLzfChunked(std::string *result) {
+  static const size_t kWindow = 8192;
+  static const size_t kReadSize = 64 << 10;
+  // a control byte, a length byte and an offset byte, or 32 literals
+  static const size_t kMaxToken = 33;
+  uint64_t compress_len, raw_len;
+  if (!LoadLength(&compress_len, NULL).ok() || !LoadLength(&raw_len, NULL).ok()
+      || raw_len == 0 || raw_len / kLzfMaxRatio > compress_len) {
+    return Status::Corruption("parse enclzf length error");
+  }
+  StatsTimer timer(stats_, kTimerLzf, sample_mask_);
+  if (stats_) {
+    stats_->lzf_bytes_in += compress_len;
+    stats_->lzf_bytes_out += raw_len;
+  }
+  std::string in;
+  size_t in_pos = 0;
+  uint64_t in_left = compress_len;
+  // output of the current chunk starts at out_start, the bytes before it
+  // are the window of the previous chunks
+  std::string &out = lzf_window_;
+  out.clear();
+  size_t out_start = 0;
+  uint64_t delivered = 0;
+  Status s;
+  while (s.ok() && (in_pos < in.size() || in_left > 0)) {
+    if (in.size() - in_pos < kMaxToken && in_left > 0) {
+      in.erase(0, in_pos);
+      in_pos = 0;
+      size_t n = std::min<uint64_t>(in_left, kReadSize);
+      size_t old = in.size();
+      in.resize(old + n);
+      s = Read(n, nullptr, &in[old]);
+      in_left -= n;
+      continue;
+    }
+    const uint8_t *ip = reinterpret_cast<const uint8_t *>(in.data()) + in_pos;
+    size_t avail = in.size() - in_pos;
+    size_t ctrl = ip[0];
+    if (ctrl < 32) {
+      size_t n = ctrl + 1;
+      if (avail < 1 + n) {
+        break;
+      }
+      out.append(reinterpret_cast<const char *>(ip) + 1, n);
+      in_pos += 1 + n;
+    } else {
+      size_t n = ctrl >> 5, header = 2;
+      if (n == 7) {
+        n += avail > 1 ? ip[1] : 0;
+        header = 3;
+      }
+      if (avail < header) {
+        break;
+      }
+      size_t back = ((ctrl & 0x1f) << 8) + ip[header - 1] + 1;
+      if (back > out.size()) {
+        break;
+      }
+      // the reference may overlap the bytes being written
+      size_t ref = out.size() - back;
+      for (size_t i = 0; i < n + 2; i++) {
+        out.push_back(out[ref + i]);
+      }
+      in_pos += header;
+    }
+    if (delivered + out.size() - out_start > raw_len) {
+      break;
+    }
+    if (out.size() - out_start >= options_.chunk_bytes
+        && delivered + out.size() - out_start < raw_len) {
+      result->assign(out, out_start, std::string::npos);
+      delivered += result->size();
+      s = FlushChunk();
+      out.erase(0, out.size() - std::min(out.size(), kWindow));
+      out_start = out.size();
+    }
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  if (in_pos < in.size() || in_left > 0 || delivered + out.size() - out_start != raw_len) {
+    return Status::Corruption("parse enclzf error");
+  }
+  result->assign(out, out_start, std::string::npos);
+  return Status::OK();
+}
+
+// Pass the value decoded so far to value_chunk and start the next part.
+Status RdbParseImpl::FlushChunk() {
+  result_->chunk = chunks_++ == 0 ? kFirstChunk : kMiddleChunk;
+  Status s;
+  // a push mode retry already passed the first callback_replay_ parts
+  if (callbacks_++ >= callback_replay_) {
+    s = options_.value_chunk(*result_);
+  }
+  result_->kv_value.clear();
+  result_->set_value.clear();
+  result_->map_value.clear();
+  result_->zset_value.clear();
+  result_->list_value.clear();
+  chunk_used_ = 0;
   return s;
 }
 
+void RdbParseImpl::AddListChunkBytes(const std::list<std::string> &list, size_t added) {
+  if (!chunk_on_) {
+    return;
+  }
+  auto it = list.end();
+  for (size_t i = 0; i < added; i++) {
+    --it;
+    chunk_used_ += it->size() + kChunkNodeBytes;
+  }
+}
+
 Status RdbParseImpl::LoadDouble(double *val) {
-  char buf[16];   
+  char buf[256];   
   if (!Read(1, nullptr, buf).ok()) {
     return Status::Corruption("parse load double length error"); 
   }
 
-  size_t len = static_cast<size_t>(buf[0]);
+  size_t len = static_cast<uint8_t>(buf[0]);
   switch (len) {
     case 255: 
-      *val = std::numeric_limits<double>::max(); 
+      *val = -std::numeric_limits<double>::infinity(); 
       break;
     case 254:
-      *val = std::numeric_limits<double>::min();
+      *val = std::numeric_limits<double>::infinity();
       break;
     case 253:
       *val = std::numeric_limits<double>::quiet_NaN();
       break;
     default: 
       {
-        if (Read(static_cast<uint64_t>(len), nullptr, buf).ok()
-            && string2d(buf, len, val)) {
+        Status s = Read(static_cast<uint64_t>(len), nullptr, buf);
+        buf[len] = '\0';
+        if (s.ok() && string2d(buf, len, val)) {
           return Status::OK();
         } else {
           return Status::Corruption("string2double failed");
@@ -466,7 +1309,11 @@ Status RdbParseImpl::LoadBinaryDouble(double *val) {
   char *ptr = reinterpret_cast<char *>(val);
   Status s = Read(sizeof(*val), nullptr, ptr); 
   if (!s.ok()) { return s; }
-  MayReverseMemory(ptr, sizeof(*val));
+  // stored little endian, unlike the big endian 32/64 bit lengths that
+  // MayReverseMemory converts
+  if (!kLittleEndian) {
+    std::reverse(ptr, ptr + sizeof(*val));
+  }
   return Status::OK();
 }
 Status RdbParseImpl::SkipString() {
@@ -501,7 +1348,23 @@ Status RdbParseImpl::SkipString() {
         return Status::Corruption("");
     }  
   }
-  return sequence_file_->Skip(skip_bytes);
+  return Skip(skip_bytes);
+}
+Status RdbParseImpl::SkipStrings(uint64_t per_element) {
+  uint64_t len, first;
+  if (!LoadElements(&len, &first).ok()) {
+    return Status::Corruption("skip length error");
+  }
+  for (uint64_t i = first; i < len; i++) {
+    ElementBoundary(i, len);
+    for (uint64_t j = 0; j < per_element; j++) {
+      Status s = SkipString();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+  return Status::OK();
 }
 
 
@@ -551,7 +1414,7 @@ Status RdbParseImpl::LoadEntryValue(uint8_t type) {
   Status s;
   switch (type) {
     case kRdbString:  
-      s = LoadString(&(result_->kv_value)); 
+      s = LoadStringValue(&(result_->kv_value)); 
       break; 
     case kRdbIntset:
       s = LoadIntset(&(result_->set_value));               
@@ -581,52 +1444,139 @@ Status RdbParseImpl::LoadEntryValue(uint8_t type) {
       break;
     case kRdbModule:
       s = Status::Corruption("parse key module error");
+      break;
     case kRdbModule2: 
       s = SkipModule();
       break;
     case kRdbStreamListpacks:
-      s = SkipStream();
+    case kRdbStreamListpacks2:
+    case kRdbStreamListpacks3:
+      s = LoadStream(type, &(result_->stream_value));
       break;
     case kRdbListQuicklist:
       s = LoadListQuicklist(&(result_->list_value));
       break;
+    case kRdbHashListpack:
+    case kRdbZsetListpack:
+      s = LoadZsetOrHashListpack(&(result_->map_value));
+      break;
+    case kRdbSetListpack:
+      s = LoadSetListpack(&(result_->set_value));
+      break;
+    case kRdbListQuicklist2:
+      s = LoadListQuicklist2(&(result_->list_value));
+      break;
     default: 
-      s = Status::OK(); // skip unrecognised value type
+      // its length is unknown, nothing after it can be found
+      s = Status::Corruption("unknown value type", std::to_string(static_cast<int>(type)));
   }
   return s; 
 }
+Status RdbParseImpl::SkipEntryValue(uint8_t type) {
+  switch (type) {
+    case kRdbString:
+    case kRdbIntset:
+    case kRdbListZiplist:
+    case kRdbHashZipmap:
+    case kRdbZsetZiplist:
+    case kRdbHashZiplist:
+    case kRdbHashListpack:
+    case kRdbZsetListpack:
+    case kRdbSetListpack:
+      return SkipString();
+    case kRdbListQuicklist2:
+      return SkipQuicklist2();
+    case kRdbList:
+    case kRdbSet:
+    case kRdbListQuicklist:
+      return SkipStrings(1);
+    case kRdbHash:
+      return SkipStrings(2);
+    case kRdbZset:
+    case kRdbZset2:
+      {
+        uint64_t len, first;
+        if (!LoadElements(&len, &first).ok()) {
+          return Status::Corruption("skip zset error");
+        }
+        for (uint64_t i = first; i < len; i++) {
+          ElementBoundary(i, len);
+          Status s = SkipString();
+          if (s.ok()) {
+            s = type == kRdbZset2 ? SkipBinaryDouble() : SkipDouble();
+          }
+          if (!s.ok()) {
+            return s;
+          }
+        }
+        return Status::OK();
+      }
+    case kRdbModule:
+      return Status::Corruption("parse key module error");
+    case kRdbModule2:
+      return SkipModule();
+    case kRdbStreamListpacks:
+    case kRdbStreamListpacks2:
+    case kRdbStreamListpacks3:
+      return SkipStream(type);
+    default:
+      return Status::Corruption("unknown value type", std::to_string(static_cast<int>(type)));
+  }
+}
 Status RdbParseImpl::LoadIntset(std::set<std::string> *result) {
-  std::string value;
-  if (!LoadString(&value).ok()) {
+  if (!LoadString(&listpack_buf_).ok()
+      || !Intset::Valid(listpack_buf_.data(), listpack_buf_.size())) {
     return Status::Corruption("Parse intset error");
   }
 
-  size_t i;
-  Intset *int_set = reinterpret_cast<Intset *>((void *)(value.data())); 
-  for (i = 0; i < int_set->length; i++) {
-    int64_t v64;
-    if (!int_set->Get(i, &v64).ok()) {
-      break; 
-    }
-    result->emplace(std::to_string(v64));
-  } 
-  return i == int_set->length ? 
-    Status::OK() : Status::Corruption("Parse intset error");
+  StatsTimer timer(stats_, kTimerIntset, sample_mask_);
+  TRACE_SPAN("intset");
+  const Intset *int_set = reinterpret_cast<const Intset *>(listpack_buf_.data());
+  std::vector<int64_t> &values = options_.intset_as_ints
+    ? result_->intset_value : intset_values_;
+  values.resize(int_set->length);
+  int_set->GetAll(values.data());
+  if (options_.intset_as_ints) {
+    return Status::OK();
+  }
+  char buf[24];
+  for (int64_t v : values) {
+    result->emplace(buf, FormatInt64(v, buf));
+  }
+  if (stats_) {
+    stats_->allocations += values.size();
+  }
+  return Status::OK();
 }
 bool RdbParseImpl::Valid() {
   return valid_;
 }
 Status RdbParseImpl::Next() {
-  ResetResult(); 
   Status s;
+  if (pending_.active) {
+    // push mode: the value the last try cut goes on at pending_.next
+    resuming_ = true;
+    if (!pending_.expired) {
+      return ReadEntryValue(pending_.type);
+    }
+    s = DropExpiredValue(pending_.type);
+    if (!s.ok()) { return s; }
+  } else {
+    ResetResult(); 
+    if (!options_.checkpoint_path.empty()) {
+      s = MaybeCheckpoint();
+      if (!s.ok()) { return s; }
+    }
+  }
   while (1) {
     uint8_t type;
+    uint64_t entry_offset = offset_;
     if (!LoadEntryType(&type).ok()) {
       return Status::Corruption("parse type error");
     }
     // set expire time
     if (type == kExpireMs || type == kExpireSec) {
-      int expire_time;
+      int64_t expire_time;
       if (!LoadExpiretime(type, &expire_time).ok()) {
         return Status::Corruption("parse expire time error");
       }
@@ -647,9 +1597,9 @@ Status RdbParseImpl::Next() {
       }
     }
     if (type == kFreq) {
-      uint64_t freq; 
-      if (!LoadLength(&freq, NULL).ok()) {
-        return Status::Corruption("parse idle error");
+      uint8_t freq = 0;
+      if (!LoadUint8(&freq).ok()) {
+        return Status::Corruption("parse freq error");
       };
       result_->set_freq(static_cast<uint32_t>(freq));
       if (!LoadEntryType(&type).ok()) {
@@ -670,6 +1620,7 @@ Status RdbParseImpl::Next() {
         return Status::Corruption("parse aux kv error");
       } 
       result_->set_auxkv(k, v); 
+      aux_fields_.push_back(result_->aux_field);
       continue;
     }
     if (type == kResizedb) {
@@ -687,21 +1638,290 @@ Status RdbParseImpl::Next() {
       }
       continue; 
     }
+    // the code of a function library, not a key
+    if (type == kFunction2) {
+      if (!SkipString().ok()) {
+        return Status::Corruption("parse function error");
+      }
+      continue;
+    }
+    // cluster slot sizes, hints for the loader
+    if (type == kSlotInfo) {
+      uint64_t slot;
+      for (int i = 0; i < 3; i++) {
+        if (!LoadLength(&slot, NULL).ok()) {
+          return Status::Corruption("parse slot info error");
+        }
+      }
+      continue;
+    }
     if (type == kEof) {
+      if (options_.follow && version_ >= 5) {
+        s = VerifyChecksum();
+        if (!s.ok()) { return s; }
+      }
       valid_ = false;
+      if (progress_on_) {
+        MaybeReportProgress(true);
+      }
       return Status::OK(); 
     }
     // load object
+    TRACE_KEY_SPAN("entry", result_->key, entry_offset);
     s = LoadEntryKey(&(result_->key));        
     if (!s.ok()) { return s; } 
-    result_->type = GetTypeName(ValueType(type));
-    s = LoadEntryValue(type);
-    return s;
+    // redis drops a key on load when expire < now
+    if (options_.expired_as_of_ms && result_->expire_time != -1
+        && result_->expire_time < options_.expired_as_of_ms) {
+      s = DropExpiredValue(type);
+      if (!s.ok()) { return s; }
+      continue;
+    }
+    result_->type = GetTypeName(type);
+    result_->rdb_type = type;
+    if (stats_) {
+      stats_->keys++;
+      stats_->keys_per_type[type % ParseStats::kMaxTypes]++;
+    }
+    return ReadEntryValue(type);
   }
 } 
 
-std::string RdbParseImpl::GetTypeName(ValueType type) {
-  static std::unordered_map<ValueType, std::string, std::hash<int>> type_map {
+Status RdbParseImpl::ReadEntryValue(uint8_t type) {
+  pending_.type = type;
+  pending_.expired = false;
+  if (options_.capture_raw) {
+    capture_ = &result_->raw_value;
+  }
+  Status s = options_.decode_value ? LoadEntryValue(type) : SkipEntryValue(type);
+  pending_.active = false;
+  resuming_ = false;
+  capture_ = NULL;
+  if (chunks_) {
+    result_->chunk = kLastChunk;
+  }
+  keys_++;
+  if (progress_on_) {
+    MaybeReportProgress(false);
+  }
+  return s;
+}
+
+Status RdbParseImpl::DropExpiredValue(uint8_t type) {
+  pending_.type = type;
+  pending_.expired = true;
+  Status s = SkipEntryValue(type);
+  pending_.active = false;
+  resuming_ = false;
+  if (!s.ok()) { return s; }
+  if (stats_) {
+    stats_->expired_keys++;
+  }
+  if (progress_on_) {
+    MaybeReportProgress(false);
+  }
+  ResetResult();
+  return Status::OK();
+}
+
+Status RdbParseImpl::LoadElements(uint64_t *count, uint64_t *first) {
+  if (resuming_) {
+    resuming_ = false;
+    *count = pending_.count;
+    *first = pending_.next;
+    return Status::OK();
+  }
+  *first = 0;
+  return LoadLength(count, NULL);
+}
+
+// The crc64 of everything up to and including the EOF opcode follows it,
+// little endian. 0 means the saver had rdbchecksum off.
+Status RdbParseImpl::VerifyChecksum() {
+  char buf[8];
+  ReleaseWindow();
+  Status s = sequence_file_->Read(8, NULL, buf);
+  if (!s.ok()) {
+    return s;
+  }
+  offset_ += 8;
+  uint64_t expected;
+  memcpy(&expected, buf, 8);
+  if (expected != 0 && !check_sum_partial_ && expected != check_sum_) {
+    return Status::Corruption("rdb checksum mismatch");
+  }
+  return Status::OK();
+}
+
+void RdbParseImpl::MaybeReportProgress(bool done) {
+  // the clock is only read every 256 keys unless the byte step passed
+  bool bytes_due = options_.progress_bytes && offset_ >= progress_next_offset_;
+  if (!done && !bytes_due && (++progress_checks_ & 255) != 0) {
+    return;
+  }
+  uint64_t now = NowNanos();
+  bool time_due = options_.progress_interval_ms && now >= progress_next_ns_;
+  if (!done && !bytes_due && !time_due) {
+    return;
+  }
+  progress_next_offset_ = offset_ + options_.progress_bytes;
+  progress_next_ns_ = now + options_.progress_interval_ms * 1000000ULL;
+
+  ParseProgress p;
+  p.path = path_;
+  p.offset = offset_;
+  p.total_bytes = total_bytes_;
+  p.keys = keys_;
+  p.elapsed_secs = (now - progress_start_ns_) / 1e9;
+  p.bytes_per_sec = p.elapsed_secs > 0 ? offset_ / p.elapsed_secs : 0;
+  p.keys_per_sec = p.elapsed_secs > 0 ? keys_ / p.elapsed_secs : 0;
+  p.eta_secs = done ? 0 : -1;
+  if (!done && p.bytes_per_sec > 0 && total_bytes_ >= offset_) {
+    p.eta_secs = (total_bytes_ - offset_) / p.bytes_per_sec;
+  }
+  p.done = done;
+  if (options_.progress) {
+    options_.progress(p);
+  }
+  if (!options_.progress_textfile.empty()) {
+    WritePrometheusTextfile(options_.progress_textfile, p);
+  }
+}
+
+Status RdbParseImpl::GetCheckpoint(ParseCheckpoint *checkpoint) {
+  if (!valid_) {
+    return Status::InvalidArgument("parse already finished");
+  }
+  SyncChecksum();
+  checkpoint->version = version_;
+  checkpoint->offset = offset_;
+  checkpoint->file_size = total_bytes_;
+  checkpoint->db_num = result_->db_num;
+  checkpoint->db_size = result_->db_size;
+  checkpoint->expire_size = result_->expire_size;
+  checkpoint->check_sum = check_sum_;
+  checkpoint->check_sum_partial = check_sum_partial_;
+  checkpoint->keys = keys_;
+  checkpoint->aux_fields = aux_fields_;
+  return Status::OK();
+}
+
+// Called right after Init(), the header was read already.
+Status RdbParseImpl::Resume(const ParseCheckpoint &checkpoint) {
+  if (checkpoint.version != version_) {
+    return Status::InvalidArgument("checkpoint of another rdb version");
+  }
+  if (checkpoint.file_size && total_bytes_ && checkpoint.file_size != total_bytes_) {
+    return Status::InvalidArgument("checkpoint of another file size");
+  }
+  if (checkpoint.offset < offset_) {
+    return Status::InvalidArgument("checkpoint offset inside the header");
+  }
+  // the crc of the skipped bytes comes with the checkpoint
+  ReleaseWindow();
+  Status s = sequence_file_->Skip(checkpoint.offset - offset_);
+  if (!s.ok()) {
+    return s;
+  }
+  offset_ = checkpoint.offset;
+  check_sum_ = checkpoint.check_sum;
+  check_sum_partial_ = checkpoint.check_sum_partial;
+  keys_ = checkpoint.keys;
+  aux_fields_ = checkpoint.aux_fields;
+  result_->db_num = checkpoint.db_num;
+  result_->db_size = checkpoint.db_size;
+  result_->expire_size = checkpoint.expire_size;
+  progress_next_offset_ = offset_;
+  return Status::OK();
+}
+
+Status RdbParseImpl::MaybeCheckpoint() {
+  // the clock is only read every 256 entries
+  if ((checkpoint_checks_++ & 255) != 0) {
+    return Status::OK();
+  }
+  uint64_t now = NowNanos();
+  if (now < checkpoint_next_ns_) {
+    return Status::OK();
+  }
+  checkpoint_next_ns_ = now + options_.checkpoint_interval_ms * 1000000ULL;
+  ParseCheckpoint checkpoint;
+  Status s = GetCheckpoint(&checkpoint);
+  return s.ok() ? WriteCheckpoint(options_.checkpoint_path, checkpoint) : s;
+}
+
+// Mark the buffer at the read position, a failed read rewinds to here.
+void RdbParseImpl::Commit() {
+  ReleaseWindow();
+  buffer_->Mark();
+  commit_.check_sum = check_sum_;
+  commit_.check_sum_partial = check_sum_partial_;
+  commit_.offset = offset_;
+  commit_.keys = keys_;
+  commit_.aux_count = aux_fields_.size();
+  commit_.db_num = result_->db_num;
+  commit_.db_size = result_->db_size;
+  commit_.expire_size = result_->expire_size;
+  commit_.raw_size = result_->raw_value.size();
+  commit_.callbacks = callbacks_;
+  commit_.chunk_used = chunk_used_;
+  commit_.chunks = chunks_;
+  commit_.pending = pending_;
+  if (stats_) {
+    commit_.stats = *stats_;
+  }
+}
+
+void RdbParseImpl::RestoreCommit() {
+  buffer_->Rewind();
+  check_sum_ = commit_.check_sum;
+  check_sum_partial_ = commit_.check_sum_partial;
+  offset_ = commit_.offset;
+  keys_ = commit_.keys;
+  aux_fields_.resize(commit_.aux_count);
+  result_->db_num = commit_.db_num;
+  result_->db_size = commit_.db_size;
+  result_->expire_size = commit_.expire_size;
+  if (result_->raw_value.size() > commit_.raw_size) {
+    result_->raw_value.resize(commit_.raw_size);
+  }
+  callbacks_ = commit_.callbacks;
+  chunk_used_ = commit_.chunk_used;
+  chunks_ = commit_.chunks;
+  pending_ = commit_.pending;
+  resuming_ = false;
+  if (stats_) {
+    *stats_ = commit_.stats;
+  }
+}
+
+template <typename F>
+Status RdbParseImpl::TryParse(F parse) {
+  Commit();
+  Status s = parse();
+  // the buffer may move once the caller appends to it
+  ReleaseWindow();
+  if (!buffer_->exhausted()) {
+    callback_replay_ = 0;
+    return s;
+  }
+  callback_replay_ = std::max(callback_replay_, callbacks_);
+  RestoreCommit();
+  valid_ = true;
+  return Status::Incomplete("need more data");
+}
+
+Status RdbParseImpl::TryInit() {
+  return TryParse([this]() { return Init(); });
+}
+
+Status RdbParseImpl::TryNext() {
+  return TryParse([this]() { return Next(); });
+}
+
+// |type| is the byte read from the file, not always a ValueType
+std::string RdbParseImpl::GetTypeName(uint8_t type) {
+  static std::unordered_map<int, std::string> type_map {
     { kRdbString, "string"}, { kRdbList, "list"},
       { kRdbSet, "set"}, { kRdbHashZipmap,"hash"},
       { kRdbZset, "zset"}, { kRdbHashZiplist, "hash"},
@@ -709,15 +1929,22 @@ std::string RdbParseImpl::GetTypeName(ValueType type) {
       { kRdbHash,"hash"}, { kRdbZsetZiplist,"zset"},
       { kRdbListQuicklist,"list"}, { kRdbStreamListpacks,"stream"},
       { kRdbModule,"module"}, { kRdbModule2,"module"},
-      { kRdbZset2, "zset"},
+      { kRdbZset2, "zset"}, { kRdbHashListpack, "hash"},
+      { kRdbZsetListpack, "zset"}, { kRdbListQuicklist2, "list"},
+      { kRdbStreamListpacks2, "stream"}, { kRdbSetListpack, "set"},
+      { kRdbStreamListpacks3, "stream"},
   };
   auto it = type_map.find(type);  
   return it != type_map.end() ? it->second : ""; 
 }
 
 Status RdbParse::Open(const std::string &path, RdbParse **rdb) {
+  return Open(path, ParseOptions(), rdb);
+}
+Status RdbParse::Open(const std::string &path, const ParseOptions &options,
+    RdbParse **rdb) {
   *rdb = nullptr;
-  RdbParseImpl *impl = new RdbParseImpl(path);
+  RdbParseImpl *impl = new RdbParseImpl(path, options);
   Status s = impl->Init(); 
   if (!s.ok()) {
     delete impl;
@@ -726,6 +1953,21 @@ Status RdbParse::Open(const std::string &path, RdbParse **rdb) {
   *rdb = impl;
   return Status::OK();
 }
+Status RdbParse::Open(const std::string &path, const ParseCheckpoint &resume_from,
+    const ParseOptions &options, RdbParse **rdb) {
+  *rdb = nullptr;
+  RdbParseImpl *impl = new RdbParseImpl(path, options);
+  Status s = impl->Init();
+  if (s.ok()) {
+    s = impl->Resume(resume_from);
+  }
+  if (!s.ok()) {
+    delete impl;
+    return s;
+  }
+  *rdb = impl;
+  return Status::OK();
+}
 RdbParse::~RdbParse() {
 }
 
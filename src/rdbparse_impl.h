@@ -4,8 +4,11 @@
 #include <set>
 #include <list>
 #include <map> 
+#include <vector>
 #include <unordered_map>
 #include "include/rdbparse.h"
+#include "include/parse_checkpoint.h"
+#include "thread_pool.h"
 #include "util.h"
 
 
@@ -26,12 +29,47 @@ enum ValueType {
   kRdbZsetZiplist = 12,       
   kRdbHashZiplist = 13,
   kRdbListQuicklist = 14,
-  kRdbStreamListpacks = 15
+  kRdbStreamListpacks = 15,
+  kRdbHashListpack = 16,
+  kRdbZsetListpack = 17,
+  kRdbListQuicklist2 = 18,
+  kRdbStreamListpacks2 = 19,
+  kRdbSetListpack = 20,
+  kRdbStreamListpacks3 = 21
+};
+
+// Times one call of a ParseStats timer when the call is sampled, costs a
+// branch when stats are off.
+class StatsTimer {
+  public:
+    StatsTimer(ParseStats *stats, ParseTimer timer, uint32_t sample_mask)
+      : stats_(NULL), timer_(timer), start_(0) {
+      if (stats && (stats->timer_calls[timer]++ & sample_mask) == 0) {
+        stats_ = stats;
+        start_ = NowNanos();
+      }
+    }
+    ~StatsTimer() {
+      if (stats_) {
+        stats_->timer_samples[timer_]++;
+        stats_->timer_sampled_nanos[timer_] += NowNanos() - start_;
+      }
+    }
+  private:
+    ParseStats *stats_;
+    ParseTimer timer_;
+    uint64_t start_;
 };
 
 class RdbParseImpl : public RdbParse {
   public:
-    RdbParseImpl(const std::string& rdb_path); 
+    RdbParseImpl(const std::string& rdb_path, const ParseOptions &options); 
+    // Decode quicklists and decompress zstd frames on |pool|, shared with
+    // other parsers, instead of pools of its own.
+    RdbParseImpl(const std::string& rdb_path, const ParseOptions &options,
+        ThreadPool *pool);
+    // Parse |buffer|, owned by the parser, see TryInit and TryNext.
+    RdbParseImpl(BufferSequentialFile *buffer, const ParseOptions &options);
     ~RdbParseImpl();
 
     enum EntryType {
@@ -43,8 +81,20 @@ class RdbParseImpl : public RdbParse {
       kFreq = 0xf9,
       kAux = 0xfa,
       kResizedb = 0xfb, 
+      kFunction2 = 0xf5,
+      kSlotInfo = 0xf4,
       kEof = 0xff
     };
+    // flags of a stream listpack entry
+    enum StreamItemFlag {
+      kStreamItemDeleted = 1,
+      kStreamItemSameFields = 2
+    };
+    // container of a quicklist2 node
+    enum QuicklistNodeType {
+      kQuicklistNodePlain = 1,
+      kQuicklistNodePacked = 2
+    };
     enum LengthType {
       k6B = 0,   
       k14B,
@@ -71,25 +121,57 @@ class RdbParseImpl : public RdbParse {
     const static int kMagicVersion = 5;
     Status Init(); 
     Status Next();
+    // Push mode: run Init() or Next() over the buffered bytes. When they
+    // run out first the parser is rolled back to where it was and
+    // Incomplete is returned, to be retried once more bytes came.
+    Status TryInit();
+    Status TryNext();
     bool Valid(); 
     ParsedResult *Value(); 
+    int Version() { return version_; }
+    const std::vector<AuxKV> &AuxFields() { return aux_fields_; }
+    const ParseStats *Stats() { return stats_; }
+    Status GetCheckpoint(ParseCheckpoint *checkpoint);
+    Status Resume(const ParseCheckpoint &checkpoint);
     void ResetResult(); 
-    Status Read(uint64_t len, Slice *result, char *scratch);
-    Status LoadExpiretime(uint8_t type, int *expire_time); 
+    // Reads served from the file buffer (see SequentialFile::Peek) are a
+    // bounds check and a copy; the checksum of those bytes is brought up
+    // to date in bulk, by SyncChecksum.
+    Status Read(uint64_t len, Slice *result, char *scratch) {
+      const char *p = ReadInPlace(len);
+      if (p == NULL) {
+        return ReadSlow(len, result, scratch);
+      }
+      memcpy(scratch, p, len);
+      if (result) {
+        *result = Slice(scratch, len);
+      }
+      return Status::OK();
+    }
+    Status LoadExpiretime(uint8_t type, int64_t *expire_ms); 
     Status LoadEntryType(uint8_t *type);
     Status LoadEntryDBNum(uint8_t *db_num);
     Status LoadEntryKey(std::string *result);     
     Status LoadEntryValue(uint8_t type);
+    Status SkipEntryValue(uint8_t type);
 
-    std::string GetTypeName(ValueType type);
+    std::string GetTypeName(uint8_t type);
   private: 
+    friend class RdbParseBench;
     Status LoadLength(uint64_t *length, bool *is_encoded);
     Status LoadIntVal(uint32_t type, std::string *result); 
     Status LoadString(std::string *result);
+    // A plain string already in the window comes back pointing into it,
+    // valid until the next read; others are loaded into |scratch|.
+    Status LoadStringInPlace(Slice *result, std::string *scratch);
     Status LoadDouble(double *val);
     Status LoadBinaryDouble(double *val);
     Status LoadIntset(std::set<std::string> *result);
     Status LoadEncLzf(std::string *result);
+    // LZF turns 3 bytes into at most 264
+    static const uint64_t kLzfMaxRatio = 88;
+    static const uint64_t kUncheckedStringBytes = 1 << 20;
+    Status ReadString(uint64_t len, std::string *result);
     Status LoadListZiplist(std::list<std::string> *result);
     Status LoadZsetOrHashZiplist(std::map<std::string, std::string> *result); 
     Status LoadZipmap(std::map<std::string, std::string> *result);
@@ -97,53 +179,195 @@ class RdbParseImpl : public RdbParse {
     Status LoadHash(std::map<std::string, std::string> *result);
     Status LoadZset(std::map<std::string, double> *result, bool is_zset2 = false);
     Status LoadListQuicklist(std::list<std::string> *result);
+    Status LoadListQuicklist2(std::list<std::string> *result);
+    struct QuicklistNode;
+    Status ReadQuicklistNode(QuicklistNode *node);
+    static Status DecodeQuicklistNodes(QuicklistNode *nodes, size_t n,
+        bool quicklist2, std::list<std::string> *out);
+    Status LoadQuicklistParallel(uint64_t nodes, bool quicklist2,
+        std::list<std::string> *result);
+    Status LoadZsetOrHashListpack(std::map<std::string, std::string> *result);
+    Status LoadSetListpack(std::set<std::string> *result);
     Status SkipModule();  // skip module   
     Status LoadUint8(uint8_t *ch) {
       char buf[1];
-      Status s = Read(1, NULL, buf);
-      if (!s.ok()) {
-        return s;
+      const char *p = ReadInPlace(1);
+      if (p == NULL) {
+        Status s = ReadSlow(1, NULL, buf);
+        if (!s.ok()) {
+          return s;
+        }
+        p = buf;
       }
-      *ch = static_cast<uint8_t>(buf[0]);
+      *ch = static_cast<uint8_t>(*p);
       return Status::OK();
     } 
-    Status SkipStream();
+    Status Skip(uint64_t len);
+    Status SkipStream(uint8_t type);
+    Status LoadStream(uint8_t type, StreamInfo *info);
+    Status LoadStreamListpack(const Slice &listpack, const StreamId &master);
+    Status LoadStreamId(StreamId *id);
+    Status LoadMillisecondTime(int64_t *ms);
+    Status SkipQuicklist2();
     Status SkipString(); 
+    Status SkipStrings(uint64_t per_element);
     Status SkipFloat() {
-      uint8_t skip_bytes = 0;
-      Status s = LoadUint8(&skip_bytes);
-      if(s.ok() && skip_bytes < 253) {
-        return sequence_file_->Skip(skip_bytes); 
-      }
-      return s;
+      return Skip(sizeof(float));
     }
     Status SkipBinaryDouble() {
-      return sequence_file_->Skip(sizeof(double));
+      return Skip(sizeof(double));
     }
     Status SkipDouble() {
-      char buf[16];   
-      if (!Read(1, nullptr, buf).ok()) {
+      uint8_t len = 0;
+      if (!LoadUint8(&len).ok()) {
         return Status::Corruption("parse load double length error"); 
       }
-      uint64_t skip_bytes = 0;
-      size_t len = static_cast<size_t>(buf[0]);
-      if (len != 255 || len != 254 || len != 253) {
-          skip_bytes = len; 
-      } 
-      return sequence_file_->Skip(skip_bytes);
+      // 253, 254 and 255 stand for nan, -inf and inf with no payload
+      return len < 253 ? Skip(len) : Status::OK();
+    }
+    // |len| bytes consumed straight from the window, NULL when fewer are
+    // left in it
+    const char *ReadInPlace(uint64_t len) {
+      if (len > static_cast<uint64_t>(limit_ - next_)) {
+        return NULL;
+      }
+      const char *p = next_;
+      next_ += len;
+      offset_ += len;
+      if (stats_) {
+        stats_->bytes_read += len;
+        stats_->read_calls++;
+      }
+      if (capture_) {
+        capture_->append(p, len);
+      }
+      return p;
     }
+    Status ReadSlow(uint64_t len, Slice *result, char *scratch);
+    void SyncChecksum();
+    // Hand the consumed part of the window back to the file, before any
+    // other call on it.
+    void ReleaseWindow();
     std::string path_;
+    ParseOptions options_;
     SequentialFile *sequence_file_;  
+    // the bytes of sequence_file_->Peek(): window_ is where it started,
+    // next_ the read position, crc_from_ the first byte not in check_sum_
+    const char *window_;
+    const char *next_;
+    const char *limit_;
+    const char *crc_from_;
     uint64_t check_sum_; 
+    // skipped bytes were left out of check_sum_, it cannot be verified
+    bool check_sum_partial_;
     int version_;  
     ParsedResult *result_;
+    std::string *capture_;
+    ParseStats *stats_;
+    uint32_t sample_mask_;
+    BufferSequentialFile *buffer_;
+    template <typename F> Status TryParse(F parse);
+    // push mode: a value cut inside its elements goes on from the element
+    // the failed read belongs to instead of from the key
+    struct PendingValue {
+      PendingValue() : active(false), expired(false), type(0), count(0), next(0) {}
+      bool active;
+      bool expired;
+      uint8_t type;
+      uint64_t count;
+      uint64_t next;
+    };
+    PendingValue pending_;
+    bool resuming_;
+    Status LoadElements(uint64_t *count, uint64_t *first);
+    void ElementBoundary(uint64_t next, uint64_t count) {
+      if (buffer_) {
+        pending_.active = true;
+        pending_.count = count;
+        pending_.next = next;
+        Commit();
+      }
+    }
+    Status ReadEntryValue(uint8_t type);
+    Status DropExpiredValue(uint8_t type);
+    // the state a push mode retry starts from, taken at the buffer mark
+    struct Snapshot {
+      uint64_t check_sum;
+      bool check_sum_partial;
+      uint64_t offset;
+      uint64_t keys;
+      size_t aux_count;
+      uint32_t db_num;
+      uint32_t db_size;
+      uint32_t expire_size;
+      size_t raw_size;
+      uint64_t callbacks;
+      uint64_t chunk_used;
+      uint32_t chunks;
+      PendingValue pending;
+      ParseStats stats;
+    };
+    Snapshot commit_;
+    void Commit();
+    void RestoreCommit();
+    Status VerifyChecksum();
+    // progress reporting, see ParseOptions::progress
+    void MaybeReportProgress(bool done);
+    uint64_t offset_;
+    uint64_t keys_;
+    uint64_t total_bytes_;
+    bool progress_on_;
+    uint32_t progress_checks_;
+    uint64_t progress_start_ns_;
+    uint64_t progress_next_offset_;
+    uint64_t progress_next_ns_;
+    std::vector<AuxKV> aux_fields_;
+    // listpacks that are compressed or not in the window, and intsets, are
+    // decoded from here, kept across keys
+    std::string listpack_buf_;
+    std::vector<int64_t> intset_values_;
+    // compressed bytes of the LZF string being loaded
+    std::string lzf_in_;
+    // stream entries are built here, master_ints_ and entry_ints_ hold
+    // the integers among the fields printed
+    StreamEntry stream_entry_;
+    std::vector<Slice> master_fields_;
+    std::vector<char> master_ints_;
+    std::vector<char> entry_ints_;
+    // stream entries and value chunks of the current key passed to their
+    // callbacks, and how many of them a push mode retry must not pass again
+    uint64_t callbacks_;
+    uint64_t callback_replay_;
+    // chunked values, see ParseOptions::chunk_bytes
+    bool ChunkFull() const {
+      return chunk_on_ && chunk_used_ >= options_.chunk_bytes;
+    }
+    void ChunkAdd(size_t bytes) {
+      chunk_used_ += bytes;
+    }
+    Status FlushChunk();
+    // counted per decoded element on top of its bytes
+    static const size_t kChunkNodeBytes = 32;
+    void AddListChunkBytes(const std::list<std::string> &list, size_t added);
+    Status LoadStringValue(std::string *result);
+    Status LoadEncLzfChunked(std::string *result);
+    void CountStringEncoding(bool is_encoded, uint64_t len);
+    bool chunk_on_;
+    uint64_t chunk_used_;
+    uint32_t chunks_;
+    std::string lzf_window_;
+    // quicklist nodes are decoded here, see ParseOptions::decode_threads
+    ThreadPool *decode_pool_;
+    // not owned, see the constructor
+    ThreadPool *shared_pool_;
+    Status MaybeCheckpoint();
+    uint32_t checkpoint_checks_;
+    uint64_t checkpoint_next_ns_;
     struct Arena;
     bool valid_;
     Arena *arena_;
     RdbParseImpl(const RdbParseImpl&);
     RdbParseImpl& operator=(const RdbParseImpl&);
 };
-const std::string RdbParseImpl::kMagicString = "REDIS";
-
 }
 #endif
@@ -0,0 +1,463 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <functional>
+
+#include "include/resp_exporter.h"
+#include "include/rdb_dump.h"
+#include "numeric.h"
+#include "util.h"
+
+namespace parser {
+
+static const size_t kMaxPendingWrite = 4 << 20;
+
+void RespEncoder::AppendArrayHeader(size_t n, std::string *out) {
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "*%zu\r\n", n);
+  out->append(buf, len);
+}
+void RespEncoder::AppendBulk(const Slice &arg, std::string *out) {
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "$%zu\r\n", arg.size());
+  out->append(buf, len);
+  out->append(arg.data(), arg.size());
+  out->append("\r\n", 2);
+}
+void RespEncoder::AppendCommand(const std::vector<Slice> &argv, std::string *out) {
+  AppendArrayHeader(argv.size(), out);
+  for (const Slice &arg : argv) {
+    AppendBulk(arg, out);
+  }
+}
+
+// Emit |total| elements as commands of at most batch_elements_ elements,
+// each element taking |width| arguments appended by |append_one|.
+static size_t AppendBatched(const char *cmd, const Slice &key, size_t total,
+    size_t batch, size_t width, const std::function<void(std::string *)> &append_one,
+    std::string *out) {
+  size_t commands = 0;
+  while (total > 0) {
+    size_t n = total < batch ? total : batch;
+    RespEncoder::AppendArrayHeader(2 + n * width, out);
+    RespEncoder::AppendBulk(cmd, out);
+    RespEncoder::AppendBulk(key, out);
+    for (size_t i = 0; i < n; i++) {
+      append_one(out);
+    }
+    total -= n;
+    commands++;
+  }
+  return commands;
+}
+
+static Slice FormatScore(double score, char *buf, size_t size) {
+  int len = snprintf(buf, size, "%.17g", score);
+  return Slice(buf, len);
+}
+
+Status RespEncoder::Encode(const ParsedResult &r, bool replace,
+    std::string *out, size_t *commands) const {
+  *commands = 0;
+  Slice key(r.key);
+  const std::string &type = r.type;
+  bool collection = type == "list" || type == "set"
+    || type == "hash" || type == "zset";
+  if (type != "string" && !collection) {
+    return Status::NotSupported("no command for type", type);
+  }
+  // parts of a chunked value after the first add to what it began
+  bool first = r.chunk == kWholeValue || r.chunk == kFirstChunk;
+  bool last = r.chunk == kWholeValue || r.chunk == kLastChunk;
+  if (collection && replace && first) {
+    AppendCommand({"DEL", key}, out);
+    (*commands)++;
+  }
+
+  size_t n = 0;
+  if (type == "string") {
+    AppendCommand({first ? "SET" : "APPEND", key, r.kv_value}, out);
+    n = 1;
+  } else if (type == "set" && !r.intset_value.empty()) {
+    auto it = r.intset_value.begin();
+    char buf[24];
+    n = AppendBatched("SADD", key, r.intset_value.size(), batch_elements_, 1,
+        [&](std::string *o) { AppendBulk(Slice(buf, FormatInt64(*it++, buf)), o); }, out);
+  } else if (type == "list" || (type == "set" && r.set_value.empty())) {
+    auto it = r.list_value.begin();
+    n = AppendBatched(type == "list" ? "RPUSH" : "SADD", key,
+        r.list_value.size(), batch_elements_, 1,
+        [&](std::string *o) { AppendBulk(*it++, o); }, out);
+  } else if (type == "set") {
+    auto it = r.set_value.begin();
+    n = AppendBatched("SADD", key, r.set_value.size(), batch_elements_, 1,
+        [&](std::string *o) { AppendBulk(*it++, o); }, out);
+  } else if (type == "hash") {
+    auto it = r.map_value.begin();
+    n = AppendBatched("HSET", key, r.map_value.size(), batch_elements_, 2,
+        [&](std::string *o) {
+          AppendBulk(it->first, o);
+          AppendBulk(it->second, o);
+          ++it;
+        }, out);
+  } else if (!r.zset_value.empty()) {
+    auto it = r.zset_value.begin();
+    char buf[32];
+    n = AppendBatched("ZADD", key, r.zset_value.size(), batch_elements_, 2,
+        [&](std::string *o) {
+          AppendBulk(FormatScore(it->second, buf, sizeof(buf)), o);
+          AppendBulk(it->first, o);
+          ++it;
+        }, out);
+  } else {
+    // ziplist encoded zsets keep their scores as strings
+    auto it = r.map_value.begin();
+    n = AppendBatched("ZADD", key, r.map_value.size(), batch_elements_, 2,
+        [&](std::string *o) {
+          AppendBulk(it->second, o);
+          AppendBulk(it->first, o);
+          ++it;
+        }, out);
+  }
+  *commands += n;
+
+  if (r.expire_time != -1 && n > 0 && last) {
+    char ms[20];
+    AppendCommand({"PEXPIREAT", key, Slice(ms, FormatInt64(r.expire_time, ms))}, out);
+    (*commands)++;
+  }
+  return Status::OK();
+}
+
+Status RespEncoder::EncodeRestore(const ParsedResult &r, int rdb_version,
+    bool replace, std::string *out, size_t *commands) const {
+  *commands = 0;
+  if (r.raw_value.empty()) {
+    return Status::InvalidArgument("no raw value captured", r.key);
+  }
+  std::string payload;
+  CreateDumpPayload(r, rdb_version, &payload);
+  char ttl[20] = "0";
+  size_t ttl_len = r.expire_time == -1 ? 1 : FormatInt64(r.expire_time, ttl);
+  std::vector<Slice> argv{"RESTORE", r.key, Slice(ttl, ttl_len), payload};
+  if (replace) {
+    argv.push_back("REPLACE");
+  }
+  if (r.expire_time != -1) {
+    argv.push_back("ABSTTL");
+  }
+  AppendCommand(argv, out);
+  *commands = 1;
+  return Status::OK();
+}
+
+struct RespExporter::Conn {
+  Conn() : fd(-1), db(0), wpos(0), inflight(0) {}
+  ~Conn() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  int fd;
+  int64_t db;
+  std::string wbuf;
+  size_t wpos;
+  std::string rbuf;
+  uint64_t inflight;
+};
+
+// Returns 1 when a complete reply starts at |p|, 0 when more bytes are
+// needed and -1 when the bytes are not RESP.
+static int ParseReply(const char *p, size_t n, size_t *used, bool *is_err) {
+  if (n == 0) {
+    return 0;
+  }
+  const char *eol = static_cast<const char *>(memchr(p, '\n', n));
+  if (eol == NULL) {
+    return 0;
+  }
+  size_t line = eol - p + 1;
+  if (line < 3 || p[line - 2] != '\r') {
+    return -1;
+  }
+  long long v = 0;
+  switch (p[0]) {
+    case '-':
+      *is_err = true;
+      // fall through
+    case '+':
+    case ':':
+      *used = line;
+      return 1;
+    case '$':
+      if (!string2ll(p + 1, line - 3, &v)) {
+        return -1;
+      }
+      if (v < 0) {
+        *used = line;
+        return 1;
+      }
+      if (n < line + v + 2) {
+        return 0;
+      }
+      *used = line + v + 2;
+      return 1;
+    case '*':
+      {
+        if (!string2ll(p + 1, line - 3, &v)) {
+          return -1;
+        }
+        size_t off = line;
+        for (long long i = 0; i < v; i++) {
+          size_t sub = 0;
+          bool err = false;
+          int r = ParseReply(p + off, n - off, &sub, &err);
+          if (r != 1) {
+            return r;
+          }
+          off += sub;
+        }
+        *used = off;
+        return 1;
+      }
+    default:
+      return -1;
+  }
+}
+
+RespExporter::RespExporter(const RespExporterOptions &options)
+  : options_(options), encoder_(options.batch_elements),
+    commands_(0), replies_(0), errors_(0), skipped_(0) {
+  if (options_.connections < 1) {
+    options_.connections = 1;
+  }
+  if (options_.pipeline_window < 1) {
+    options_.pipeline_window = 1;
+  }
+}
+
+RespExporter::~RespExporter() {
+  for (Conn *c : conns_) {
+    delete c;
+  }
+}
+
+Status RespExporter::Open(const std::string &host, int port,
+    const RespExporterOptions &options, RespExporter **exporter) {
+  *exporter = nullptr;
+  RespExporter *impl = new RespExporter(options);
+  Status s;
+  for (int i = 0; i < impl->options_.connections && s.ok(); i++) {
+    Conn *c = new Conn;
+    impl->conns_.push_back(c);
+    s = TcpConnect(host, port, &c->fd);
+    if (s.ok() && !options.password.empty()) {
+      RespEncoder::AppendCommand({"AUTH", options.password}, &c->wbuf);
+      c->inflight++;
+    }
+  }
+  if (s.ok()) {
+    s = impl->Flush();
+  }
+  if (s.ok() && impl->errors_ > 0) {
+    s = Status::AuthFailed(host, impl->first_error_);
+  }
+  if (!s.ok()) {
+    delete impl;
+    return s;
+  }
+  impl->commands_ = impl->replies_ = 0;
+  *exporter = impl;
+  return Status::OK();
+}
+
+RespExporter::Conn *RespExporter::Route(const Slice &key) {
+  size_t h = std::hash<std::string>()(key.ToString());
+  return conns_[h % conns_.size()];
+}
+
+Status RespExporter::Append(const ParsedResult &result) {
+  if (result.key.empty() && result.type.empty()) {
+    return Status::OK();
+  }
+  scratch_.clear();
+  size_t n = 0;
+  Status s = encoder_.Encode(result, options_.replace, &scratch_, &n);
+  return QueueEncoded(result, s, n);
+}
+
+Status RespExporter::AppendRestore(const ParsedResult &result, int rdb_version) {
+  if (result.key.empty() && result.type.empty()) {
+    return Status::OK();
+  }
+  scratch_.clear();
+  size_t n = 0;
+  Status s = encoder_.EncodeRestore(result, rdb_version, options_.replace,
+      &scratch_, &n);
+  return QueueEncoded(result, s, n);
+}
+
+Status RespExporter::QueueEncoded(const ParsedResult &result,
+    const Status &encoded, size_t n) {
+  if (encoded.IsNotSupported()) {
+    skipped_++;
+    return Status::OK();
+  }
+  if (!encoded.ok() || n == 0) {
+    return encoded;
+  }
+  return Queue(Route(result.key), result.db_num, scratch_, n);
+}
+
+Status RespExporter::AppendCommand(const std::vector<Slice> &argv, uint32_t db_num) {
+  if (argv.empty()) {
+    return Status::InvalidArgument("empty command");
+  }
+  scratch_.clear();
+  RespEncoder::AppendCommand(argv, &scratch_);
+  return Queue(Route(argv.size() > 1 ? argv[1] : argv[0]), db_num, scratch_, 1);
+}
+
+Status RespExporter::Queue(Conn *conn, uint32_t db_num,
+    const std::string &cmds, size_t n) {
+  if (conn->db != static_cast<int64_t>(db_num)) {
+    std::string db = std::to_string(db_num);
+    RespEncoder::AppendCommand({"SELECT", db}, &conn->wbuf);
+    conn->inflight++;
+    commands_++;
+  }
+  conn->db = db_num;
+  conn->wbuf.append(cmds);
+  conn->inflight += n;
+  commands_ += n;
+
+  Status s;
+  if (conn->wbuf.size() - conn->wpos >= kMaxPendingWrite) {
+    s = HandleWrite(conn);
+  }
+  while (s.ok() && (conn->inflight > static_cast<uint64_t>(options_.pipeline_window)
+        || conn->wbuf.size() - conn->wpos >= kMaxPendingWrite)) {
+    s = Pump(false);
+  }
+  return s;
+}
+
+Status RespExporter::Flush() {
+  return Pump(true);
+}
+
+Status RespExporter::Pump(bool drain) {
+  std::vector<struct pollfd> fds(conns_.size());
+  do {
+    bool busy = false;
+    for (size_t i = 0; i < conns_.size(); i++) {
+      Conn *c = conns_[i];
+      fds[i].fd = c->fd;
+      fds[i].events = 0;
+      fds[i].revents = 0;
+      if (c->wpos < c->wbuf.size()) {
+        fds[i].events |= POLLOUT;
+      }
+      if (c->inflight > 0) {
+        fds[i].events |= POLLIN;
+      }
+      busy = busy || fds[i].events != 0;
+    }
+    if (!busy) {
+      return Status::OK();
+    }
+    int r = poll(&fds[0], fds.size(), options_.timeout_ms);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError("poll", strerror(errno));
+    }
+    if (r == 0) {
+      return Status::Timeout("no reply from target");
+    }
+    for (size_t i = 0; i < conns_.size(); i++) {
+      Status s;
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        s = HandleRead(conns_[i]);
+      }
+      if (s.ok() && (fds[i].revents & POLLOUT)) {
+        s = HandleWrite(conns_[i]);
+      }
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  } while (drain);
+  return Status::OK();
+}
+
+Status RespExporter::HandleWrite(Conn *conn) {
+  while (conn->wpos < conn->wbuf.size()) {
+    ssize_t w = write(conn->fd, conn->wbuf.data() + conn->wpos,
+        conn->wbuf.size() - conn->wpos);
+    if (w < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError("write", strerror(errno));
+    }
+    conn->wpos += w;
+  }
+  if (conn->wpos == conn->wbuf.size()) {
+    conn->wbuf.clear();
+    conn->wpos = 0;
+  } else if (conn->wpos > (1 << 20)) {
+    conn->wbuf.erase(0, conn->wpos);
+    conn->wpos = 0;
+  }
+  return Status::OK();
+}
+
+Status RespExporter::HandleRead(Conn *conn) {
+  char buf[16 * 1024];
+  ssize_t r = read(conn->fd, buf, sizeof(buf));
+  if (r < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return Status::OK();
+    }
+    return Status::IOError("read", strerror(errno));
+  }
+  if (r == 0) {
+    return Status::IOError("read", "connection closed by target");
+  }
+  conn->rbuf.append(buf, r);
+
+  size_t pos = 0;
+  while (pos < conn->rbuf.size()) {
+    size_t used = 0;
+    bool is_err = false;
+    int ret = ParseReply(conn->rbuf.data() + pos, conn->rbuf.size() - pos,
+        &used, &is_err);
+    if (ret < 0) {
+      return Status::Corruption("unexpected reply from target");
+    }
+    if (ret == 0) {
+      break;
+    }
+    if (is_err) {
+      errors_++;
+      if (first_error_.empty()) {
+        first_error_.assign(conn->rbuf.data() + pos + 1, used - 3);
+      }
+    }
+    replies_++;
+    if (conn->inflight > 0) {
+      conn->inflight--;
+    }
+    pos += used;
+  }
+  conn->rbuf.erase(0, pos);
+  return Status::OK();
+}
+
+}
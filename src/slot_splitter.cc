@@ -0,0 +1,262 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/slot_splitter.h"
+#include "include/resp_exporter.h"
+
+namespace parser {
+
+namespace {
+
+// CRC16-CCITT (XMODEM), the variant Redis Cluster hashes keys with.
+struct Crc16Table {
+  Crc16Table() {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = static_cast<uint16_t>(i << 8);
+      for (int j = 0; j < 8; j++) {
+        crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021)
+          : static_cast<uint16_t>(crc << 1);
+      }
+      table[i] = crc;
+    }
+  }
+  uint16_t table[256];
+};
+
+uint16_t Crc16(const char *buf, size_t len) {
+  static const Crc16Table crc16;
+  uint16_t crc = 0;
+  for (size_t i = 0; i < len; i++) {
+    crc = static_cast<uint16_t>((crc << 8)
+        ^ crc16.table[((crc >> 8) ^ static_cast<uint8_t>(buf[i])) & 0xff]);
+  }
+  return crc;
+}
+
+Status WriteAll(const std::string &path, int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t w = write(fd, data, len);
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError(path, strerror(errno));
+    }
+    data += w;
+    len -= w;
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+uint16_t KeyHashSlot(const Slice &key) {
+  const char *p = key.data();
+  size_t n = key.size();
+  const char *open = static_cast<const char *>(memchr(p, '{', n));
+  if (open != NULL) {
+    const char *begin = open + 1;
+    const char *close = static_cast<const char *>(memchr(begin, '}', p + n - begin));
+    if (close != NULL && close != begin) {
+      p = begin;
+      n = close - begin;
+    }
+  }
+  return Crc16(p, n) & (kClusterSlots - 1);
+}
+
+class SplitOutput {
+  public:
+    SplitOutput() : keys(0) {}
+    virtual ~SplitOutput() {}
+    // called once, before the first entry
+    virtual Status Start(int version, const std::vector<AuxKV> &aux) = 0;
+    virtual Status Write(const ParsedResult &result) = 0;
+    virtual Status Finish() = 0;
+
+    uint64_t keys;
+};
+
+namespace {
+
+class RdbSplitOutput : public SplitOutput {
+  public:
+    explicit RdbSplitOutput(RdbWriter *writer) : writer_(writer) {}
+    virtual ~RdbSplitOutput() {
+      delete writer_;
+    }
+    virtual Status Start(int version, const std::vector<AuxKV> &aux) {
+      Status s = writer_->WriteHeader(version);
+      for (size_t i = 0; s.ok() && i < aux.size(); i++) {
+        s = writer_->WriteAux(aux[i].aux_key, aux[i].aux_val);
+      }
+      return s;
+    }
+    virtual Status Write(const ParsedResult &result) {
+      return writer_->WriteEntry(result);
+    }
+    virtual Status Finish() {
+      return writer_->Finish();
+    }
+  private:
+    RdbWriter *writer_;
+};
+
+class RespSplitOutput : public SplitOutput {
+  public:
+    RespSplitOutput(const std::string &path, int fd, bool replace, size_t block_size)
+      : path_(path), fd_(fd), replace_(replace), block_size_(block_size),
+        version_(0), db_num_(0) {}
+    virtual ~RespSplitOutput() {
+      if (fd_ >= 0) {
+        close(fd_);
+      }
+    }
+    virtual Status Start(int version, const std::vector<AuxKV> &aux) {
+      version_ = version;
+      return Status::OK();
+    }
+    virtual Status Write(const ParsedResult &result) {
+      if (result.db_num != db_num_) {
+        std::string db = std::to_string(result.db_num);
+        RespEncoder::AppendCommand({"SELECT", db}, &buf_);
+        db_num_ = result.db_num;
+      }
+      size_t n = 0;
+      Status s = encoder_.EncodeRestore(result, version_, replace_, &buf_, &n);
+      if (s.ok() && buf_.size() >= block_size_) {
+        s = Flush();
+      }
+      return s;
+    }
+    virtual Status Finish() {
+      Status s = Flush();
+      if (close(fd_) != 0 && s.ok()) {
+        s = Status::IOError(path_, strerror(errno));
+      }
+      fd_ = -1;
+      return s;
+    }
+  private:
+    Status Flush() {
+      Status s = WriteAll(path_, fd_, buf_.data(), buf_.size());
+      buf_.clear();
+      return s;
+    }
+
+    std::string path_;
+    int fd_;
+    bool replace_;
+    size_t block_size_;
+    int version_;
+    uint32_t db_num_;
+    RespEncoder encoder_;
+    std::string buf_;
+};
+
+}  // namespace
+
+SlotSplitter::SlotSplitter()
+  : slot_output_(kClusterSlots, -1), keys_(0), dropped_(0) {
+}
+
+SlotSplitter::~SlotSplitter() {
+  for (SplitOutput *output : outputs_) {
+    delete output;
+  }
+}
+
+Status SlotSplitter::AddOutput(SplitOutput *output, const std::vector<SlotRange> &ranges) {
+  int32_t index = static_cast<int32_t>(outputs_.size());
+  for (const SlotRange &r : ranges) {
+    if (r.first > r.last || r.last >= kClusterSlots) {
+      delete output;
+      return Status::InvalidArgument("bad slot range");
+    }
+    for (int slot = r.first; slot <= r.last; slot++) {
+      if (slot_output_[slot] != -1 && slot_output_[slot] != index) {
+        delete output;
+        return Status::InvalidArgument("slot owned by two outputs", std::to_string(slot));
+      }
+    }
+  }
+  for (const SlotRange &r : ranges) {
+    for (int slot = r.first; slot <= r.last; slot++) {
+      slot_output_[slot] = index;
+    }
+  }
+  outputs_.push_back(output);
+  return Status::OK();
+}
+
+Status SlotSplitter::AddRdbOutput(const std::string &path,
+    const std::vector<SlotRange> &ranges, const RdbWriterOptions &options) {
+  RdbWriter *writer;
+  Status s = RdbWriter::Open(path, options, &writer);
+  if (!s.ok()) {
+    return s;
+  }
+  return AddOutput(new RdbSplitOutput(writer), ranges);
+}
+
+Status SlotSplitter::AddRespOutput(const std::string &path,
+    const std::vector<SlotRange> &ranges, bool replace, size_t block_size) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return Status::IOError(path, strerror(errno));
+  }
+  return AddOutput(new RespSplitOutput(path, fd, replace, block_size), ranges);
+}
+
+Status SlotSplitter::Split(const std::string &path, const ParseOptions &options) {
+  ParseOptions parse_options = options;
+  parse_options.capture_raw = true;
+  parse_options.decode_value = false;
+  RdbParse *parse;
+  Status s = RdbParse::Open(path, parse_options, &parse);
+  if (!s.ok()) {
+    return s;
+  }
+  bool started = false;
+  while (s.ok() && parse->Valid()) {
+    s = parse->Next();
+    if (!s.ok()) {
+      break;
+    }
+    if (!started) {
+      // every aux field precedes the first key
+      for (size_t i = 0; s.ok() && i < outputs_.size(); i++) {
+        s = outputs_[i]->Start(parse->Version(), parse->AuxFields());
+      }
+      started = true;
+    }
+    ParsedResult *value = parse->Value();
+    if (!s.ok() || !parse->Valid() || value->key.empty()) {
+      continue;
+    }
+    keys_++;
+    int32_t index = slot_output_[KeyHashSlot(value->key)];
+    if (index < 0) {
+      dropped_++;
+      continue;
+    }
+    s = outputs_[index]->Write(*value);
+    outputs_[index]->keys++;
+  }
+  delete parse;
+  for (size_t i = 0; started && i < outputs_.size(); i++) {
+    Status f = outputs_[i]->Finish();
+    if (s.ok()) {
+      s = f;
+    }
+  }
+  return s;
+}
+
+uint64_t SlotSplitter::output_keys(size_t index) const {
+  return index < outputs_.size() ? outputs_[index]->keys : 0;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parser {
+
+// Fixed set of workers running submitted tasks in FIFO order.
+class ThreadPool {
+  public:
+    // |threads| <= 0 uses one worker per core
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> Submit(F f) {
+      typedef typename std::result_of<F()>::type R;
+      std::shared_ptr<std::packaged_task<R()>> task(new std::packaged_task<R()>(f));
+      std::future<R> result = task->get_future();
+      Schedule([task]() { (*task)(); });
+      return result;
+    }
+    int size() const { return static_cast<int>(workers_.size()); }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+  private:
+    void Schedule(std::function<void()> task);
+    void Work();
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+    bool stop_;
+};
+
+}
+#endif
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace_impl.h"
+
+#ifdef __ENABLE_TRACE
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace parser {
+
+#ifdef __ENABLE_TRACE
+
+namespace {
+
+struct TraceEvent {
+  const char *name;
+  uint64_t start_ns;
+  uint64_t dur_ns;
+  uint64_t arg;
+};
+
+// Single producer ring, the owning thread overwrites the oldest events.
+// Slots are written with relaxed atomics and |written| is bumped before a
+// slot is, so an export running alongside can tell which copies it made may
+// have been overwritten and drop them.
+struct TraceSlot {
+  std::atomic<const char *> name;
+  std::atomic<uint64_t> start_ns;
+  std::atomic<uint64_t> dur_ns;
+  std::atomic<uint64_t> arg;
+};
+
+struct TraceRing {
+  static const uint64_t kCapacity = 1 << 18;
+
+  explicit TraceRing(uint32_t t) : tid(t), head(0), written(0), tail(0), slots(kCapacity) {}
+  void Push(const TraceEvent &e) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    written.store(h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceSlot &slot = slots[h & (kCapacity - 1)];
+    slot.name.store(e.name, std::memory_order_relaxed);
+    slot.start_ns.store(e.start_ns, std::memory_order_relaxed);
+    slot.dur_ns.store(e.dur_ns, std::memory_order_relaxed);
+    slot.arg.store(e.arg, std::memory_order_relaxed);
+    head.store(h + 1, std::memory_order_release);
+  }
+  // Copy the events in [tail, head) still held by the ring, newest first so
+  // that a producer lapping the export only costs the oldest ones.
+  void Snapshot(std::vector<TraceEvent> *events) {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = tail.load(std::memory_order_relaxed);
+    if (end > kCapacity && begin < end - kCapacity) {
+      begin = end - kCapacity;
+    }
+    events->clear();
+    for (uint64_t i = end; i > begin; i--) {
+      const TraceSlot &slot = slots[(i - 1) & (kCapacity - 1)];
+      TraceEvent e = {slot.name.load(std::memory_order_relaxed),
+        slot.start_ns.load(std::memory_order_relaxed),
+        slot.dur_ns.load(std::memory_order_relaxed),
+        slot.arg.load(std::memory_order_relaxed)};
+      // the slot of event i - 1 is reused by event i - 1 + kCapacity
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (written.load(std::memory_order_relaxed) >= i + kCapacity) {
+        break;
+      }
+      events->push_back(e);
+    }
+    std::reverse(events->begin(), events->end());
+  }
+
+  uint32_t tid;
+  // events published
+  std::atomic<uint64_t> head;
+  // events whose slot write started
+  std::atomic<uint64_t> written;
+  // first event not cleared, only moved by TraceClear
+  std::atomic<uint64_t> tail;
+  std::vector<TraceSlot> slots;
+};
+
+struct SlowKey {
+  std::string key;
+  uint64_t offset;
+  uint64_t start_ns;
+  uint64_t dur_ns;
+  uint32_t tid;
+};
+
+const size_t kMaxSlowKeys = 10000;
+
+// Rings outlive their threads so a late export still sees their events.
+std::mutex g_mu;
+std::vector<TraceRing *> g_rings;
+std::vector<SlowKey> g_slow_keys;
+std::atomic<uint64_t> g_slow_key_ns(10000000);
+
+TraceRing *ThreadRing() {
+  static thread_local TraceRing *ring = NULL;
+  if (ring == NULL) {
+    std::lock_guard<std::mutex> l(g_mu);
+    ring = new TraceRing(static_cast<uint32_t>(g_rings.size() + 1));
+    g_rings.push_back(ring);
+  }
+  return ring;
+}
+
+void AppendJsonString(const std::string &s, std::string *out) {
+  char buf[8];
+  out->push_back('"');
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (c < 0x20 || c >= 0x7f) {
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out->append(buf);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendEvent(const char *name, uint32_t tid, uint64_t start_ns,
+    uint64_t dur_ns, const std::string &args, std::string *out) {
+  char buf[256];
+  snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+      "\"ts\":%.3f,\"dur\":%.3f,\"args\":{", name, static_cast<int>(getpid()),
+      tid, start_ns / 1e3, dur_ns / 1e3);
+  out->append(buf);
+  out->append(args);
+  out->append("}},\n");
+}
+
+}  // namespace
+
+void TraceRecord(const char *name, uint64_t start_ns, uint64_t dur_ns, uint64_t arg) {
+  TraceEvent e = {name, start_ns, dur_ns, arg};
+  ThreadRing()->Push(e);
+}
+
+void TraceRecordKey(const char *name, uint64_t start_ns, uint64_t dur_ns,
+    uint64_t offset, const std::string &key) {
+  TraceRing *ring = ThreadRing();
+  TraceEvent e = {name, start_ns, dur_ns, offset};
+  ring->Push(e);
+  uint64_t threshold = g_slow_key_ns.load(std::memory_order_relaxed);
+  if (threshold == 0 || dur_ns < threshold) {
+    return;
+  }
+  fprintf(stderr, "slow key %s at offset %lu took %.3f ms\n", key.c_str(),
+      offset, dur_ns / 1e6);
+  std::lock_guard<std::mutex> l(g_mu);
+  if (g_slow_keys.size() < kMaxSlowKeys) {
+    g_slow_keys.push_back(SlowKey{key, offset, start_ns, dur_ns, ring->tid});
+  }
+}
+
+bool TraceEnabled() {
+  return true;
+}
+
+void TraceSetSlowKeyThreshold(uint64_t micros) {
+  g_slow_key_ns.store(micros * 1000, std::memory_order_relaxed);
+}
+
+Status TraceExportChrome(const std::string &path) {
+  std::string out = "{\"traceEvents\":[\n";
+  char args[64];
+  {
+    std::lock_guard<std::mutex> l(g_mu);
+    std::vector<TraceEvent> events;
+    for (TraceRing *ring : g_rings) {
+      ring->Snapshot(&events);
+      for (const TraceEvent &e : events) {
+        snprintf(args, sizeof(args), "\"arg\":%lu", e.arg);
+        AppendEvent(e.name, ring->tid, e.start_ns, e.dur_ns, args, &out);
+      }
+    }
+    for (const SlowKey &k : g_slow_keys) {
+      std::string key_args = "\"key\":";
+      AppendJsonString(k.key, &key_args);
+      snprintf(args, sizeof(args), ",\"offset\":%lu", k.offset);
+      key_args.append(args);
+      AppendEvent("slow_key", k.tid, k.start_ns, k.dur_ns, key_args, &out);
+    }
+  }
+  if (out.size() > 2 && out[out.size() - 2] == ',') {
+    out.erase(out.size() - 2, 1);
+  }
+  out.append("],\"displayTimeUnit\":\"ns\"}\n");
+
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    return Status::IOError(path, strerror(errno));
+  }
+  size_t n = fwrite(out.data(), 1, out.size(), f);
+  if (fclose(f) != 0 || n != out.size()) {
+    return Status::IOError(path, strerror(errno));
+  }
+  return Status::OK();
+}
+
+void TraceClear() {
+  std::lock_guard<std::mutex> l(g_mu);
+  for (TraceRing *ring : g_rings) {
+    ring->tail.store(ring->head.load(std::memory_order_acquire),
+        std::memory_order_relaxed);
+  }
+  g_slow_keys.clear();
+}
+
+#else
+
+bool TraceEnabled() {
+  return false;
+}
+
+void TraceSetSlowKeyThreshold(uint64_t micros) {
+}
+
+Status TraceExportChrome(const std::string &path) {
+  return Status::NotSupported("tracing is not compiled in, build with ENABLE_TRACE=1");
+}
+
+void TraceClear() {
+}
+
+#endif
+
+}
@@ -0,0 +1,63 @@
+#ifndef __TRACE_IMPL_H__
+#define __TRACE_IMPL_H__
+
+#include <stdint.h>
+#include <string>
+#include "include/trace.h"
+#include "util.h"
+
+namespace parser {
+
+#ifdef __ENABLE_TRACE
+
+// Append one complete span to the calling thread's ring buffer.
+void TraceRecord(const char *name, uint64_t start_ns, uint64_t dur_ns, uint64_t arg);
+// Record a key decode span, logging it when slower than the threshold.
+void TraceRecordKey(const char *name, uint64_t start_ns, uint64_t dur_ns,
+    uint64_t offset, const std::string &key);
+
+class TraceSpan {
+  public:
+    TraceSpan(const char *name, uint64_t arg = 0, uint64_t min_ns = 0,
+        const std::string *key = NULL)
+      : name_(name), arg_(arg), min_ns_(min_ns), key_(key), start_(NowNanos()) {}
+    ~TraceSpan() {
+      uint64_t dur = NowNanos() - start_;
+      if (key_) {
+        TraceRecordKey(name_, start_, dur, arg_, *key_);
+      } else if (dur >= min_ns_) {
+        TraceRecord(name_, start_, dur, arg_);
+      }
+    }
+  private:
+    const char *name_;
+    uint64_t arg_;
+    uint64_t min_ns_;
+    const std::string *key_;
+    uint64_t start_;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+// A span lasting until the end of the enclosing scope.
+#define TRACE_SPAN(name) \
+  ::parser::TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+// Only kept when it lasts at least min_ns, for frequent calls that are
+// usually instant.
+#define TRACE_SPAN_MIN(name, min_ns) \
+  ::parser::TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, 0, min_ns)
+// The decode of |key| starting at |offset|, checked against the slow key
+// threshold. |key| is read when the scope ends.
+#define TRACE_KEY_SPAN(name, key, offset) \
+  ::parser::TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, offset, 0, &(key))
+
+#else
+
+#define TRACE_SPAN(name) ((void)0)
+#define TRACE_SPAN_MIN(name, min_ns) ((void)0)
+#define TRACE_KEY_SPAN(name, key, offset) ((void)(offset))
+
+#endif
+
+}
+#endif
@@ -1,4 +1,15 @@
 
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+
 #include "util.h"
 
 namespace parser {
@@ -10,106 +21,187 @@ Status NewSequentialFile(const std::string& fname, SequentialFile** result) {
     return Status::IOError(fname, strerror(errno));
 
   } else {
-    *result = new SequentialFile(fname, f);
+    *result = new PosixSequentialFile(fname, f);
     return Status::OK();
   }
 }
-/* Convert a string into a long long. Returns 1 if the string could be parsed
- * into a (non-overflowing) long long, 0 otherwise. The value will be set to
- * the parsed value when appropriate. */
-int string2ll(const char *s, size_t slen, long long *value) {
-    const char *p = s;
-    size_t plen = 0;
-    int negative = 0;
-    unsigned long long v;
 
-    if (plen == slen)
-        return 0;
+Status NewMmapSequentialFile(const std::string& fname, FILE* f,
+    SequentialFile** result) {
+  *result = NULL;
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0) {
+    return Status::IOError(fname, strerror(errno));
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    return Status::NotSupported(fname, "not a regular file");
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  if (base == MAP_FAILED) {
+    return Status::IOError(fname, strerror(errno));
+  }
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  *result = new MmapSequentialFile(fname, static_cast<const char *>(base), st.st_size);
+  return Status::OK();
+}
 
-    /* Special case: first and only digit is 0. */
-    if (slen == 1 && p[0] == '0') {
-        if (value != NULL) *value = 0;
-        return 1;
-    }
+MmapSequentialFile::~MmapSequentialFile() {
+  munmap(const_cast<char *>(base_), size_);
+}
 
-    if (p[0] == '-') {
-        negative = 1;
-        p++; plen++;
+Status NewFollowSequentialFile(const std::string& fname, uint32_t timeout_ms,
+    SequentialFile** result) {
+  FILE* f = fopen(fname.c_str(), "r");
+  if (f == NULL) {
+    *result = NULL;
+    return Status::IOError(fname, strerror(errno));
+  }
+  *result = new FollowSequentialFile(fname, f, timeout_ms);
+  return Status::OK();
+}
 
-        /* Abort on only a negative sign. */
-        if (plen == slen)
-            return 0;
+FollowSequentialFile::FollowSequentialFile(const std::string& fname, FILE* f,
+    uint32_t timeout_ms)
+  : filename_(fname), file_(f), timeout_ms_(timeout_ms), idle_since_ns_(0),
+    backoff_ms_(1) {
+  // without inotify (or out of watches) the file is polled
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ >= 0
+      && inotify_add_watch(inotify_fd_, fname.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+  }
+}
+
+FollowSequentialFile::~FollowSequentialFile() {
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+  fclose(file_);
+}
+
+Status FollowSequentialFile::Read(size_t n, Slice* result, char* scratch) {
+  size_t done = 0;
+  while (true) {
+    size_t r = fread_unlocked(scratch + done, 1, n - done, file_);
+    done += r;
+    if (r > 0) {
+      idle_since_ns_ = 0;
+      backoff_ms_ = 1;
     }
-    
-    while(plen < slen && p[0] == '0') {
-        p++; plen++;
+    if (done == n) {
+      break;
     }
-
-    if (plen == slen) {
-        if (value != NULL) *value = 0;
-        return 1;
+    if (ferror(file_)) {
+      return Status::IOError(filename_, strerror(errno));
     }
-
-    /* First digit should be 1-9, otherwise the string should just be 0. */
-    if (p[0] >= '1' && p[0] <= '9') {
-        v = p[0]-'0';
-        p++; plen++;
-    } else if (p[0] == '0' && slen == 1) {
-        *value = 0;
-        return 1;
-    } else {
-        return 0;
+    clearerr(file_);
+    Status s = WaitForData();
+    if (!s.ok()) {
+      return s;
     }
+  }
+  if (result) {
+    *result = Slice(scratch, n);
+  }
+  return Status::OK();
+}
 
-    while (plen < slen && p[0] >= '0' && p[0] <= '9') {
-        if (v > (ULLONG_MAX / 10)) /* Overflow. */
-            return 0;
-        v *= 10;
-
-        if (v > (ULLONG_MAX - (p[0]-'0'))) /* Overflow. */
-            return 0;
-        v += p[0]-'0';
-
-        p++; plen++;
+Status FollowSequentialFile::Skip(uint64_t n) {
+  char buf[16 * 1024];
+  while (n > 0) {
+    size_t len = n < sizeof(buf) ? n : sizeof(buf);
+    Status s = Read(len, NULL, buf);
+    if (!s.ok()) {
+      return s;
     }
+    n -= len;
+  }
+  return Status::OK();
+}
 
-    /* Return if not all bytes were used. */
-    if (plen < slen)
-        return 0;
-
-    if (negative) {
-        if (v > ((unsigned long long)(-(LLONG_MIN+1))+1)) /* Overflow. */
-            return 0;
-        if (value != NULL) *value = -v;
-    } else {
-        if (v > LLONG_MAX) /* Overflow. */
-            return 0;
-        if (value != NULL) *value = v;
+Status FollowSequentialFile::WaitForData() {
+  uint64_t now = NowNanos();
+  if (idle_since_ns_ == 0) {
+    idle_since_ns_ = now;
+  }
+  uint64_t idle_ms = (now - idle_since_ns_) / 1000000;
+  if (idle_ms >= timeout_ms_) {
+    return Status::Timeout(filename_, "file stopped growing before EOF");
+  }
+  // a failed save unlinks its temp file, it will never be completed
+  struct stat st;
+  if (fstat(fileno(file_), &st) == 0 && st.st_nlink == 0) {
+    return Status::IOError(filename_, "file removed before EOF");
+  }
+  int wait_ms = static_cast<int>(std::min<uint64_t>(timeout_ms_ - idle_ms, 1000));
+  if (inotify_fd_ >= 0) {
+    struct pollfd pfd = {inotify_fd_, POLLIN, 0};
+    if (poll(&pfd, 1, wait_ms) > 0) {
+      char events[4096];
+      while (read(inotify_fd_, events, sizeof(events)) > 0) {
+      }
     }
-    return 1;
+    return Status::OK();
+  }
+  usleep(std::min<uint32_t>(backoff_ms_, wait_ms) * 1000);
+  backoff_ms_ = std::min<uint32_t>(backoff_ms_ * 2, 100);
+  return Status::OK();
 }
-int string2l(const char *s, size_t slen, long *lval) {
-    long long llval;
 
-    if (!string2ll(s,slen,&llval))
-        return 0;
-
-    if (llval < LONG_MIN || llval > LONG_MAX)
-        return 0;
-
-    *lval = (long)llval;
-    return 1;
+Status TcpConnect(const std::string &host, int port, int *fd) {
+  struct addrinfo hints, *servinfo, *p;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  std::string port_str = std::to_string(port);
+  int rv = getaddrinfo(host.c_str(), port_str.c_str(), &hints, &servinfo);
+  if (rv != 0) {
+    return Status::IOError(host, gai_strerror(rv));
+  }
+  Status s = Status::IOError(host, "connect failed");
+  for (p = servinfo; p != NULL; p = p->ai_next) {
+    int sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+    if (sock < 0) {
+      continue;
+    }
+    if (connect(sock, p->ai_addr, p->ai_addrlen) < 0) {
+      s = Status::IOError(host, strerror(errno));
+      close(sock);
+      continue;
+    }
+    int yes = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    *fd = sock;
+    s = Status::OK();
+    break;
+  }
+  freeaddrinfo(servinfo);
+  return s;
 }
 
-int string2d(const char *s, size_t slen, double *dval) {
-  char *pEnd;
-  double d = strtod(s, &pEnd);
-  if (pEnd != s + slen)
-    return 0;
-
-  if (dval != NULL) *dval = d;
-  return 1;
-
+size_t EncodeLength(uint64_t len, char *buf) {
+  if (len < (1 << 6)) {
+    buf[0] = static_cast<char>(len);
+    return 1;
+  } else if (len < (1 << 14)) {
+    buf[0] = static_cast<char>(((len >> 8) & 0x3f) | 0x40);
+    buf[1] = static_cast<char>(len & 0xff);
+    return 2;
+  } else if (len <= UINT32_MAX) {
+    // 32 and 64 bit lengths are big endian
+    buf[0] = static_cast<char>(0x80);
+    for (int i = 0; i < 4; i++) {
+      buf[1 + i] = static_cast<char>((len >> (24 - 8 * i)) & 0xff);
+    }
+    return 5;
+  }
+  buf[0] = static_cast<char>(0x81);
+  for (int i = 0; i < 8; i++) {
+    buf[1 + i] = static_cast<char>((len >> (56 - 8 * i)) & 0xff);
+  }
+  return 9;
 }
 void MayReverseMemory(void *p, size_t len) {
   if (!kLittleEndian) {
@@ -256,7 +348,38 @@ static const uint64_t crc64_tab[256] = {
   UINT64_C(0x536fa08fdfd90e51), UINT64_C(0x29b7d047efec8728),
 };
 
+namespace {
+// crc64_tab extended for slicing-by-8: t[k][b] is the crc of byte b
+// followed by k zero bytes.
+struct Crc64Tables {
+  Crc64Tables() {
+    for (int b = 0; b < 256; b++) {
+      t[0][b] = crc64_tab[b];
+    }
+    for (int k = 1; k < 8; k++) {
+      for (int b = 0; b < 256; b++) {
+        t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff];
+      }
+    }
+  }
+  uint64_t t[8][256];
+};
+}
+
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t len) {
+  static const Crc64Tables tables;
+  const uint64_t (*t)[256] = tables.t;
+  if (kLittleEndian) {
+    for (; len >= 8; len -= 8, s += 8) {
+      uint64_t v;
+      memcpy(&v, s, sizeof(v));
+      crc ^= v;
+      crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff]
+        ^ t[5][(crc >> 16) & 0xff] ^ t[4][(crc >> 24) & 0xff]
+        ^ t[3][(crc >> 32) & 0xff] ^ t[2][(crc >> 40) & 0xff]
+        ^ t[1][(crc >> 48) & 0xff] ^ t[0][crc >> 56];
+    }
+  }
   for (uint64_t j = 0; j < len; j++) {
     uint8_t byte = s[j];
     crc = crc64_tab[(uint8_t)crc ^ byte] ^ (crc >> 8);
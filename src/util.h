@@ -1,6 +1,7 @@
 #ifndef __UTIL_H__
 #define __UTIL_H__
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <fstream>
 #include <errno.h>
 #include <stdint.h>
@@ -8,6 +9,8 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <limits>
+#include <time.h>
+#include <algorithm>
 
 #include "include/status.h"
 #include "include/slice.h"
@@ -24,13 +27,45 @@ static const bool kLittleEndian = PLATFORM_IS_LITTLE_ENDIAN;
 
 void MayReverseMemory(void *p, size_t len);
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
+static inline uint64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+static inline uint64_t DecodeBigEndian64(const char *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++) {
+    v = (v << 8) | static_cast<uint8_t>(p[i]);
+  }
+  return v;
+}
+// Encode |len| the way LoadLength reads it, |buf| needs 9 bytes.
+size_t EncodeLength(uint64_t len, char *buf);
 
 
+// Source of the rdb bytes, read front to back.
 class SequentialFile {
   public:
-    SequentialFile(const std::string& fname, FILE* f)
-      : filename_(fname), file_(f) { setbuf(file_, NULL);  }
-    virtual ~SequentialFile() {
+    virtual ~SequentialFile() {}
+    virtual Status Read(size_t n, Slice* result, char* scratch) = 0;
+    virtual Status Skip(uint64_t n) = 0;
+    // total size when known up front, 0 otherwise
+    virtual uint64_t Size() { return 0; }
+    // The bytes already in memory past the read position, empty when the
+    // file keeps none. Valid until the next call other than Advance, which
+    // consumes |n| of them.
+    virtual Slice Peek() { return Slice(); }
+    virtual void Advance(size_t n) {}
+};
+
+class PosixSequentialFile : public SequentialFile {
+  public:
+    static const size_t kReadBufferSize = 1 << 20;
+    PosixSequentialFile(const std::string& fname, FILE* f)
+      : filename_(fname), file_(f) {
+      setvbuf(file_, NULL, _IOFBF, kReadBufferSize);
+    }
+    virtual ~PosixSequentialFile() {
       if (file_) {
         fclose(file_);
       }
@@ -38,7 +73,7 @@ class SequentialFile {
     void setUnBuffer() {
       setbuf(file_, NULL);
     }
-    Status Read(size_t n, Slice* result, char* scratch) {
+    virtual Status Read(size_t n, Slice* result, char* scratch) {
       Status s;
       size_t r = fread_unlocked(scratch, 1, n, file_);
       if (result) {
@@ -48,12 +83,18 @@ class SequentialFile {
         if (feof(file_)) {
           s = Status::EndFile(filename_, "end file");
         } else {
+          s = Status::IOError(filename_, strerror(errno));
         }
       }
       return s;
     }
 
-    Status Skip(uint64_t n) {
+    virtual uint64_t Size() {
+      struct stat st;
+      return fstat(fileno(file_), &st) == 0 ? st.st_size : 0;
+    }
+
+    virtual Status Skip(uint64_t n) {
       if (fseek(file_, n, SEEK_CUR)) {
         return Status::IOError(filename_, strerror(errno));
       }
@@ -78,10 +119,134 @@ class SequentialFile {
     FILE *file_;
 };
 
+// A regular file mapped whole and read in place.
+class MmapSequentialFile : public SequentialFile {
+  public:
+    MmapSequentialFile(const std::string& fname, const char *base, size_t size)
+      : filename_(fname), base_(base), size_(size), pos_(0) {}
+    virtual ~MmapSequentialFile();
+    virtual Status Read(size_t n, Slice* result, char* scratch) {
+      size_t r = std::min(n, size_ - pos_);
+      memcpy(scratch, base_ + pos_, r);
+      pos_ += r;
+      if (result) {
+        *result = Slice(scratch, r);
+      }
+      return r < n ? Status::EndFile(filename_, "end file") : Status::OK();
+    }
+    // like fseek, a skip past the end only fails the next read
+    virtual Status Skip(uint64_t n) {
+      pos_ += std::min<uint64_t>(n, size_ - pos_);
+      return Status::OK();
+    }
+    virtual uint64_t Size() { return size_; }
+    virtual Slice Peek() { return Slice(base_ + pos_, size_ - pos_); }
+    virtual void Advance(size_t n) { pos_ += n; }
+  private:
+    std::string filename_;
+    const char *base_;
+    size_t size_;
+    size_t pos_;
+};
+
+// A file still being written, e.g. the temp file of a BGSAVE. Reads at the
+// end of the file wait for it to grow, woken by inotify or by polling with
+// backoff, and fail with Timeout once it stayed idle for |timeout_ms|.
+class FollowSequentialFile : public SequentialFile {
+  public:
+    FollowSequentialFile(const std::string& fname, FILE* f, uint32_t timeout_ms);
+    virtual ~FollowSequentialFile();
+    virtual Status Read(size_t n, Slice* result, char* scratch);
+    // reads through, a seek past the end would not wait for the bytes
+    virtual Status Skip(uint64_t n);
+  private:
+    Status WaitForData();
+
+    std::string filename_;
+    FILE *file_;
+    int inotify_fd_;
+    uint32_t timeout_ms_;
+    uint64_t idle_since_ns_;
+    uint32_t backoff_ms_;
+};
+
+// Bytes handed over by the caller, for the push parser. A read past the
+// buffered bytes fails with Incomplete and leaves the position alone, the
+// parser then rewinds to the last mark and retries once more bytes came.
+class BufferSequentialFile : public SequentialFile {
+  public:
+    BufferSequentialFile() : pos_(0), mark_(0), needed_(0), exhausted_(false) {}
+
+    // Append bytes, dropping the ones before the mark.
+    void Append(const char *data, size_t n) {
+      if (mark_ > 0 && (mark_ >= (1 << 20) || mark_ * 2 >= buf_.size())) {
+        buf_.erase(0, mark_);
+        pos_ -= mark_;
+        mark_ = 0;
+      }
+      buf_.append(data, n);
+    }
+    virtual Status Read(size_t n, Slice* result, char* scratch) {
+      if (!Reserve(n)) {
+        return Status::Incomplete("need more data");
+      }
+      memcpy(scratch, buf_.data() + pos_, n);
+      if (result) {
+        *result = Slice(scratch, n);
+      }
+      pos_ += n;
+      return Status::OK();
+    }
+    virtual Status Skip(uint64_t n) {
+      if (!Reserve(n)) {
+        return Status::Incomplete("need more data");
+      }
+      pos_ += n;
+      return Status::OK();
+    }
+
+    virtual Slice Peek() { return Slice(buf_.data() + pos_, buf_.size() - pos_); }
+    virtual void Advance(size_t n) { pos_ += n; }
+
+    void Mark() {
+      mark_ = pos_;
+      exhausted_ = false;
+    }
+    void Rewind() {
+      pos_ = mark_;
+      exhausted_ = false;
+    }
+    // whether a read ran past the buffered bytes since the last mark
+    bool exhausted() const { return exhausted_; }
+    // bytes past the mark the failed read needed
+    uint64_t needed() const { return needed_; }
+    // bytes buffered past the mark
+    uint64_t available() const { return buf_.size() - mark_; }
+  private:
+    bool Reserve(uint64_t n) {
+      if (buf_.size() - pos_ >= n) {
+        return true;
+      }
+      exhausted_ = true;
+      needed_ = pos_ - mark_ + n;
+      return false;
+    }
+    std::string buf_;
+    size_t pos_;
+    size_t mark_;
+    uint64_t needed_;
+    bool exhausted_;
+};
+
 Status NewSequentialFile(const std::string& fname, SequentialFile** result);
-int string2ll(const char *s, size_t slen, long long *value);
-int string2l(const char *s, size_t slen, long *lval); 
-int string2d(const char *s, size_t slen, double *dval);
+// Map |f| when it is a non-empty regular file, NotSupported otherwise. |f|
+// is left open for the caller.
+Status NewMmapSequentialFile(const std::string& fname, FILE* f,
+    SequentialFile** result);
+Status NewFollowSequentialFile(const std::string& fname, uint32_t timeout_ms,
+    SequentialFile** result);
+// Connect to |host|:|port|, |fd| is left non-blocking with TCP_NODELAY set.
+Status TcpConnect(const std::string &host, int port, int *fd);
 }
 #endif
 
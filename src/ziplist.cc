@@ -1,126 +1,170 @@
 #include <list>
 #include "ziplist.h"
+#include "numeric.h"
 #include "util.h"
 
 namespace parser {
 
 
-bool ZiplistParser::Ziplist::Get(size_t *offset, std::string *str, bool *end) {
-  char *p = entrys + *offset;     
-  if (static_cast<uint8_t>(*p) == kZiplistEnd) {
-    *end = true;
-    return true; 
+namespace {
+
+// Decoding of an entry's encoding byte.
+enum ZiplistEncKind {
+  kEncInvalid = 0,
+  kEncStr6,
+  kEncStr14,
+  kEncStr32,
+  kEncInt
+};
+
+struct ZiplistEncTable {
+  ZiplistEncTable() {
+    for (int b = 0; b < 256; b++) {
+      int_bytes[b] = 0;
+      header[b] = 1;
+      switch (b & kZipListStrMask) {
+        case kStrEnc6B: kind[b] = kEncStr6; break;
+        case kStrEnc14B: kind[b] = kEncStr14; header[b] = 2; break;
+        case kStrEnc32B: kind[b] = kEncStr32; header[b] = 5; break;
+        default: kind[b] = kEncInvalid; break;
+      }
+    }
+    static const uint8_t kInts[][2] = {{kIntEnc16, 2}, {kIntEnc32, 4},
+      {kIntEnc64, 8}, {kIntEnc24, 3}, {kIntEnc8, 1}};
+    for (const uint8_t *e : kInts) {
+      kind[e[0]] = kEncInt;
+      int_bytes[e[0]] = e[1];
+    }
+    // 0-12 kept in the low bits of the encoding byte
+    for (int b = 0xf1; b <= 0xfd; b++) {
+      kind[b] = kEncInt;
+    }
   }
-  p += (static_cast<uint8_t>(*p) < kZiplistBegin) ? 1 : 5;
-  *offset = p - entrys;
+  uint8_t kind[256];
+  // encoding bytes, with the string length
+  uint8_t header[256];
+  uint8_t int_bytes[256];
+};
+
+const ZiplistEncTable kEncTable;
+
+// size of the ziplist header before the first entry
+const size_t kZiplistHeaderSize = 10;
 
-  uint8_t enc = static_cast<uint8_t>(*p) & kZipListStrMask; 
-  if (enc == kStrEnc6B || enc == kStrEnc14B || enc == kStrEnc32B) {
-    return GetStr(offset, str);    
-  }    
+}  // namespace
 
-  int64_t val; 
-  if (!GetInt(offset, &val)) { 
-    return false; 
+ZiplistParser::ZiplistParser(void *buf, size_t len)
+  : handle_(reinterpret_cast<Ziplist *>(buf)), len_(len) {
   }
-  str->assign(std::to_string(val)); 
-  return true;
-}
-bool ZiplistParser::Ziplist::GetStr(size_t *offset, std::string *val) {
-  char *p = entrys + *offset;
-  uint8_t skip = 0, enc = static_cast<uint8_t>(*p) & kZipListStrMask;
-  uint32_t length = 0;
-  if (enc == kStrEnc6B) {
-    skip = 1;
-    length = static_cast<uint8_t>(p[0]) 
-      & static_cast<uint32_t>(~(kZipListStrMask)); 
-  } else if (enc == kStrEnc14B) {
-    skip = 2;
-    length = ((static_cast<uint8_t>(p[0]) & ~kZipListStrMask) << 8)
-      | static_cast<uint8_t>(p[1]);   
-  } else if (enc == kStrEnc32B) {
-    skip = 5;
-    length = (static_cast<uint8_t>(p[1]) << 24)
-      | (static_cast<uint8_t>(p[2]) << 16) 
-      | (static_cast<uint8_t>(p[3]) << 8)
-      | (static_cast<uint8_t>(p[4]));
+
+Status ZiplistParser::Scan(std::vector<ZiplistEntry> *entries) {
+  entries->clear();
+  uint32_t bytes;
+  memcpy(&bytes, &handle_->bytes, sizeof(bytes));
+  if (bytes <= kZiplistHeaderSize || (len_ && bytes > len_)) {
+    return Status::Corruption("bad ziplist size");
+  }
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(handle_->entrys);
+  // the end byte is the last one
+  const size_t limit = bytes - kZiplistHeaderSize - 1;
+  size_t off = 0;
+  while (off < limit) {
+    off += p[off] < kZiplistBegin ? 1 : 5;
+    if (off >= limit) {
+      return Status::Corruption("ziplist entry out of bounds");
+    }
+    uint8_t enc = p[off];
+    if (off + kEncTable.header[enc] > limit) {
+      return Status::Corruption("ziplist entry out of bounds");
+    }
+    ZiplistEntry e;
+    uint64_t len;
+    switch (kEncTable.kind[enc]) {
+      case kEncStr6:
+        e.offset = off + 1;
+        len = enc & ~kZipListStrMask;
+        break;
+      case kEncStr14:
+        e.offset = off + 2;
+        len = ((enc & ~kZipListStrMask) << 8) | p[off + 1];
+        break;
+      case kEncStr32:
+        e.offset = off + 5;
+        len = (static_cast<uint32_t>(p[off + 1]) << 24) | (p[off + 2] << 16)
+          | (p[off + 3] << 8) | p[off + 4];
+        break;
+      case kEncInt:
+        len = kEncTable.int_bytes[enc];
+        e.offset = len ? off + 1 : off;
+        break;
+      default:
+        return Status::Corruption("bad ziplist entry encoding");
+    }
+    e.length = static_cast<uint32_t>(len);
+    e.is_int = kEncTable.kind[enc] == kEncInt;
+    off = (e.is_int ? off + 1 : e.offset) + len;
+    if (off > limit) {
+      return Status::Corruption("ziplist entry out of bounds");
+    }
+    entries->push_back(e);
+  }
+  if (off != limit || p[limit] != kZiplistEnd) {
+    return Status::Corruption("ziplist entry out of bounds");
   }
-  p += skip;
-  val->assign(p, length);   
-   
-  *offset = p - entrys + length; 
-  return true;
+  return Status::OK();
 }
-bool ZiplistParser::Ziplist::GetInt(size_t *offset, int64_t *val) {
-  char *p = entrys + *offset; 
-  uint8_t enc = static_cast<uint8_t>(*p); 
-  p++;
-  if (enc == kIntEnc16) {
-    int16_t v16;
-    memcpy(&v16, p, 2);
-    *val = static_cast<int64_t>(v16); 
-    p += 2;
-  } else if (enc == kIntEnc32) {
-    int32_t v32;
-    memcpy(&v32, p, 4);
-    *val = v32; 
-    p += 4;
-  } else if (enc == kIntEnc64) {
-    int64_t v64;
-    memcpy(&v64, p, 8);
-    *val = v64; 
-    p += 8;
-  } else if (enc == kIntEnc24) {
-    char buf[4] = {0};
-    memcpy(buf + 1, p, 3); 
-    int32_t v32;
-    memcpy(&v32, buf, 4);
-    *val = static_cast<int64_t>(v32 >> 8); 
-    p += 3;
-  } else if (enc == kIntEnc8) {
-    int8_t v8; 
-    memcpy(&v8, p, 1);
-    *val = static_cast<int64_t>(v8);
-    p += 1;
-  } else if (enc >= 241 && enc <= 253){
-    int8_t v8 = static_cast<uint8_t>(enc) - 241; 
-    *val = static_cast<int64_t>(v8);
-  } else {
-    return false;
+
+int64_t ZiplistParser::Int(const ZiplistEntry &entry) const {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(handle_->entrys) + entry.offset;
+  if (entry.length == 0) {
+    return (*p & 0x0f) - 1;
+  }
+  uint64_t v = 0;
+  for (uint32_t i = 0; i < entry.length; i++) {
+    v |= static_cast<uint64_t>(p[i]) << (8 * i);
   }
-  *offset = p - entrys; 
-  return true;
+  // sign extend from the top bit of the last byte
+  int shift = 64 - 8 * entry.length;
+  return static_cast<int64_t>(v << shift) >> shift;
 }
-ZiplistParser::ZiplistParser(void *buf)
-  : handle_(reinterpret_cast<Ziplist *>(buf)), 
-    offset_(0) {
+
+Slice ZiplistParser::Value(const ZiplistEntry &entry, char *int_buf) const {
+  if (entry.is_int) {
+    return Slice(int_buf, FormatInt64(Int(entry), int_buf));
   }
+  return Str(entry);
+}
+
 Status ZiplistParser::GetList(std::list<std::string> *result) {
-  bool ret = true, end = false;
-  auto valid = [&] { return ret && !end; };
-  while (valid()) {
-    std::string buf;
-    ret = handle_->Get(&offset_, &buf, &end);
-    if (!valid()) { 
-      break; 
-    }
-    result->push_back(buf);
+  static thread_local std::vector<ZiplistEntry> entries;
+  Status s = Scan(&entries);
+  if (!s.ok()) {
+    return s;
+  }
+  char buf[24];
+  for (const ZiplistEntry &e : entries) {
+    Slice v = Value(e, buf);
+    result->emplace_back(v.data(), v.size());
   }
-  return ret ? Status::OK() : Status::Corruption("Parse error");
+  return Status::OK();
 }
 
 Status ZiplistParser::GetZsetOrHash(std::map<std::string, std::string> *result) {
-  bool ret = true, end = false;
-  auto valid = [&] { return ret && !end; };
-  while (valid()) {
-    std::string key, value;
-    ret = handle_->Get(&offset_, &key, &end) 
-      && handle_->Get(&offset_, &value, &end);   
-    if (!valid()) { 
-      break;
-    }
-    result->insert({key, value}); 
-  } 
-  return ret ? Status::OK() : Status::Corruption("Parse error"); 
+  static thread_local std::vector<ZiplistEntry> entries;
+  Status s = Scan(&entries);
+  if (!s.ok()) {
+    return s;
+  }
+  if (entries.size() % 2) {
+    return Status::Corruption("Parse error");
+  }
+  char kbuf[24], vbuf[24];
+  for (size_t i = 0; i < entries.size(); i += 2) {
+    Slice k = Value(entries[i], kbuf);
+    Slice v = Value(entries[i + 1], vbuf);
+    result->emplace(std::piecewise_construct, std::forward_as_tuple(k.data(), k.size()),
+        std::forward_as_tuple(v.data(), v.size()));
+  }
+  return Status::OK();
 }
 }
@@ -3,7 +3,9 @@
 
 #include <list>
 #include <map>
+#include <vector>
 #include "include/status.h"
+#include "include/slice.h"
 namespace parser {
 
 enum ZiplistFlag {
@@ -28,26 +30,44 @@ enum ZiplistIntEncType {
 };
 struct Ziplist;
 
+// Where an entry's value sits in the ziplist, see ZiplistParser::Scan.
+struct ZiplistEntry {
+  // of the string bytes, or of the little endian integer; of the encoding
+  // byte for the 0-12 integers held in it, whose length is 0
+  uint32_t offset;
+  uint32_t length;
+  bool is_int;
+};
+
 class ZiplistParser {
   public:
-    ZiplistParser(void *buf);
+    // |len| bounds the reads when given, else the ziplist's own byte count
+    // is trusted.
+    ZiplistParser(void *buf, size_t len = 0);
    
     struct Ziplist {
       uint32_t bytes;
       uint32_t ztail;
       uint16_t len;
       char entrys[0];
-      bool Get(size_t *offset, std::string *buf, bool *end);
-
-      bool GetInt(size_t *offset, int64_t *v);
-      bool GetStr(size_t *offset, std::string *v);
     };
 
     Status GetList(std::list<std::string> *result);
     Status GetZsetOrHash(std::map<std::string, std::string> *result); 
+
+    // First pass: locate every entry with a table lookup on its encoding
+    // byte, checking it stays inside the ziplist. The second pass turns
+    // entries into values with the calls below.
+    Status Scan(std::vector<ZiplistEntry> *entries);
+    int64_t Int(const ZiplistEntry &entry) const;
+    Slice Str(const ZiplistEntry &entry) const {
+      return Slice(handle_->entrys + entry.offset, entry.length);
+    }
+    // integers are printed to |int_buf|, which needs 20 bytes
+    Slice Value(const ZiplistEntry &entry, char *int_buf) const;
   private:
     Ziplist *handle_; 
-    size_t offset_;
+    size_t len_;
 };
 }
 #endif
@@ -4,69 +4,53 @@
 
 namespace parser {
 
-bool ZipmapParser::Zipmap::Get(size_t *offset, std::string *value, bool skip_free) {
-  uint8_t skip_step = skip_free ? 1 : 0;  
-  char *p = entrys + *offset;    
-  uint32_t len_size = GetEntryLenSize(p);
-  uint32_t str_len = GetEntryStrLen(len_size, p);
-  value->append(p + len_size + skip_step, str_len); 
-  p += (len_size + str_len + skip_step);
-  *offset = p - entrys;
-  return true;
-}
-bool ZipmapParser::Zipmap::GetKV(size_t *offset, std::string *key, std::string *value, bool *end) {
-  if (IsEnd(offset)) {
-    *end = true;
-    return true;
+// Length in front of a key or value, 0xfe announces 4 more bytes.
+static bool ReadZipmapLen(const uint8_t **p, const uint8_t *end, uint32_t *len) {
+  if (*p >= end) {
+    return false;
   }
-  Get(offset, key, false);
-  Get(offset, value, true);
-  return true;
-}
-bool ZipmapParser::Zipmap::IsEnd(size_t *offset) {
-  char *p = entrys + *offset;    
-  if (static_cast<uint8_t>(*p) == kZipmapEnd) { 
-    return true; 
-  }
-  return false;
-}
-uint32_t ZipmapParser::Zipmap::GetEntryLenSize(char *entry) {
-  uint32_t size = 0; 
-  uint8_t flag = static_cast<uint8_t>(entry[0]);
-  if (flag < kZipmapBiglen) {
-    size = 1;
-  } else if (flag == kZipmapBiglen) {
-    size = 5; 
+  uint8_t flag = **p;
+  if (flag < ZipmapParser::kZipmapBiglen) {
+    *len = flag;
+    *p += 1;
+    return true;
   }
-  return size;
-}
-uint32_t ZipmapParser::Zipmap::GetEntryStrLen(uint8_t len_size, char *entry) {
-  uint32_t str_len = 0;
-  if (len_size == 1) {
-    str_len = static_cast<uint32_t>(entry[0]);
-  } else if (len_size == 5) {
-    memcpy(&str_len, entry + 1, 4); 
+  if (flag != ZipmapParser::kZipmapBiglen || end - *p < 5) {
+    return false;
   }
-  return str_len; 
+  memcpy(len, *p + 1, 4);
+  *p += 5;
+  return true;
 }
-ZipmapParser::ZipmapParser(void *buf)
-  : handle_(reinterpret_cast<ZipmapParser::Zipmap *>(buf)), 
-    offset_(0) {
+
+ZipmapParser::ZipmapParser(void *buf, size_t len)
+  : buf_(reinterpret_cast<const uint8_t *>(buf)), len_(len) {
 }
 
 Status ZipmapParser::GetMap(std::map<std::string, std::string> *result) {
-  bool ret = true, end = false;
-  auto valid = [&] { return ret && !end; };
-  offset_ += 1;
-  while (valid()) {
-    std::string key, value;
-    ret = handle_->GetKV(&offset_, &key, &value, &end);
-    if (!valid()) { 
-      break; 
+  // skip the entry count, only exact below 254
+  const uint8_t *p = buf_ + 1, *end = buf_ + len_;
+  while (p < end && *p != kZipmapEnd) {
+    uint32_t key_len, value_len;
+    if (!ReadZipmapLen(&p, end, &key_len) || static_cast<size_t>(end - p) < key_len) {
+      break;
+    }
+    const uint8_t *key = p;
+    p += key_len;
+    if (!ReadZipmapLen(&p, end, &value_len) || p >= end) {
+      break;
+    }
+    // values are followed by a one byte count of unused trailing bytes
+    uint8_t free_len = *p++;
+    if (static_cast<size_t>(end - p) < static_cast<uint64_t>(value_len) + free_len) {
+      break;
     }
-    result->insert({key, value});
+    result->emplace(std::piecewise_construct,
+        std::forward_as_tuple(reinterpret_cast<const char *>(key), key_len),
+        std::forward_as_tuple(reinterpret_cast<const char *>(p), value_len));
+    p += value_len + free_len;
   }
-  return ret ? Status::OK() : Status::Corruption("Parse error");
+  return p < end && *p == kZipmapEnd ? Status::OK() : Status::Corruption("Parse error");
 }
 
 }
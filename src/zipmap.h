@@ -9,24 +9,17 @@ namespace parser {
 
 class ZipmapParser {
   public:
-    ZipmapParser(void  *buf); 
+    // every length inside the |len| bytes at |buf| is checked against them
+    ZipmapParser(void *buf, size_t len);
     enum Mark {
       kZipmapEnd = 0xff, 
-      kZipmapBiglen = 0xfd,
-    };
-    struct Zipmap {
-       char entrys[0];         
-       bool Get(size_t *offset, std::string *value, bool skip_free);
-       bool GetKV(size_t *offset, std::string *key, std::string *value, bool *end); 
-       bool IsEnd(size_t *offset);
-       uint32_t GetEntryLenSize(char *entry); 
-       uint32_t GetEntryStrLen(uint8_t len_size, char *entry); 
+      kZipmapBiglen = 0xfe,
     };
     
     Status GetMap(std::map<std::string, std::string> *result);
   private:
-    Zipmap *handle_;
-    size_t offset_;     
+    const uint8_t *buf_;
+    size_t len_;
 };
 }
 #endif